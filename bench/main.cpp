@@ -0,0 +1,336 @@
+#include <benchmark/benchmark.h>
+#include "ent.hpp"
+#include <deque>
+#include <random>
+
+// Column types of a few different sizes.
+template <size_t Size> struct col { std::array<float, Size / sizeof(float)> values; };
+using small_col  = col<4>;
+using medium_col = col<16>;
+using large_col  = col<64>;
+
+struct position { float value; };
+struct velocity { float value; };
+struct gain     { float value; };
+
+template <size_t BlockSize>
+using voice_table = ent::table<BlockSize, position, velocity, gain>;
+
+template <typename Table>
+auto fill(Table& table, size_t rows) -> void {
+	for (size_t i = 0; i < rows; ++i) {
+		table.template get<position>(table.acquire(ent::lock)).value = static_cast<float>(i);
+	}
+}
+
+// Leaves roughly (occupancy_percent)% of the rows acquired, scattered randomly.
+template <typename Table>
+auto fill_sparse(Table& table, size_t rows, int occupancy_percent) -> void {
+	fill(table, rows);
+	std::mt19937 rng{1234};
+	std::uniform_int_distribution<int> dist{0, 99};
+	for (size_t i = 0; i < rows; ++i) {
+		if (dist(rng) >= occupancy_percent) {
+			table.release(ent::lock, i);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// acquire / release
+//------------------------------------------------------------------------------
+
+template <size_t BlockSize>
+static void acquire_release_locked(benchmark::State& state) {
+	voice_table<BlockSize> table;
+	fill(table, BlockSize / 2);
+	for (auto _ : state) {
+		const auto idx = table.acquire(ent::lock);
+		benchmark::DoNotOptimize(idx);
+		table.release(ent::lock, idx);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(acquire_release_locked, 64);
+BENCHMARK_TEMPLATE(acquire_release_locked, 512);
+BENCHMARK_TEMPLATE(acquire_release_locked, 4096);
+
+template <size_t BlockSize>
+static void acquire_release_lock_free(benchmark::State& state) {
+	voice_table<BlockSize> table;
+	fill(table, BlockSize / 2);
+	for (auto _ : state) {
+		const auto idx = table.try_acquire();
+		benchmark::DoNotOptimize(idx);
+		table.release(*idx);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(acquire_release_lock_free, 64);
+BENCHMARK_TEMPLATE(acquire_release_lock_free, 512);
+BENCHMARK_TEMPLATE(acquire_release_lock_free, 4096);
+
+// Fills an empty table from scratch, including block allocation.
+template <size_t BlockSize>
+static void acquire_fill(benchmark::State& state) {
+	const auto rows = static_cast<size_t>(state.range(0));
+	for (auto _ : state) {
+		voice_table<BlockSize> table;
+		fill(table, rows);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(acquire_fill, 512)->Arg(512)->Arg(8192);
+
+//------------------------------------------------------------------------------
+// Contention. Every thread shares one table.
+//------------------------------------------------------------------------------
+
+static voice_table<512>* shared_table = nullptr;
+
+static void contended_acquire_release_locked(benchmark::State& state) {
+	if (state.thread_index() == 0) {
+		shared_table = new voice_table<512>;
+		fill(*shared_table, 256);
+	}
+	for (auto _ : state) {
+		const auto idx = shared_table->acquire(ent::lock);
+		benchmark::DoNotOptimize(idx);
+		shared_table->release(ent::lock, idx);
+	}
+	state.SetItemsProcessed(state.iterations());
+	if (state.thread_index() == 0) {
+		delete shared_table;
+	}
+}
+BENCHMARK(contended_acquire_release_locked)->ThreadRange(1, 8)->UseRealTime();
+
+static void contended_acquire_release_lock_free(benchmark::State& state) {
+	if (state.thread_index() == 0) {
+		shared_table = new voice_table<512>;
+		fill(*shared_table, 256);
+	}
+	for (auto _ : state) {
+		if (const auto idx = shared_table->try_acquire()) {
+			shared_table->release(*idx);
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+	if (state.thread_index() == 0) {
+		delete shared_table;
+	}
+}
+BENCHMARK(contended_acquire_release_lock_free)->ThreadRange(1, 8)->UseRealTime();
+
+static void contended_acquire_release_cached(benchmark::State& state) {
+	// Caches are made before the benchmark loop starts and flushed after it
+	// ends, so this table is never deleted.
+	static auto table = voice_table<512>{};
+	voice_table<512>::local_cache cache{table};
+	for (auto _ : state) {
+		const auto idx = cache.acquire(ent::lock);
+		benchmark::DoNotOptimize(idx);
+		cache.release(idx);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(contended_acquire_release_cached)->ThreadRange(1, 8)->UseRealTime();
+
+//------------------------------------------------------------------------------
+// get<T> latency by block index
+//------------------------------------------------------------------------------
+
+static void get_by_block_index(benchmark::State& state) {
+	constexpr size_t block_size = 64;
+	const auto blocks = static_cast<size_t>(state.range(0));
+	voice_table<block_size> table;
+	fill(table, blocks * block_size);
+	// Always read from the last block.
+	const auto first = (blocks - 1) * block_size;
+	size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(table.get<gain>(first + (i++ % block_size)));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(get_by_block_index)->DenseRange(1, 16, 3);
+
+static void get_by_block_index_deque(benchmark::State& state) {
+	constexpr size_t block_size = 64;
+	const auto blocks = static_cast<size_t>(state.range(0));
+	std::deque<gain> deque(blocks * block_size);
+	const auto first = (blocks - 1) * block_size;
+	size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(deque[first + (i++ % block_size)]);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(get_by_block_index_deque)->DenseRange(1, 16, 3);
+
+//------------------------------------------------------------------------------
+// Visit bandwidth
+//------------------------------------------------------------------------------
+
+static constexpr size_t visit_rows = 1 << 16;
+
+template <size_t BlockSize>
+static void visit_column(benchmark::State& state) {
+	voice_table<BlockSize> table;
+	fill(table, visit_rows);
+	for (auto _ : state) {
+		table.template visit<gain>(ent::lock, [](size_t, gain& g) { g.value *= 0.5f; });
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * visit_rows * sizeof(gain));
+}
+BENCHMARK_TEMPLATE(visit_column, 64);
+BENCHMARK_TEMPLATE(visit_column, 512);
+BENCHMARK_TEMPLATE(visit_column, 4096);
+
+template <size_t BlockSize>
+static void visit_index_get(benchmark::State& state) {
+	voice_table<BlockSize> table;
+	fill(table, visit_rows);
+	for (auto _ : state) {
+		table.visit(ent::lock, [&table](size_t i) { table.template get<gain>(i).value *= 0.5f; });
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * visit_rows * sizeof(gain));
+}
+BENCHMARK_TEMPLATE(visit_index_get, 512);
+
+template <size_t BlockSize>
+static void visit_spans_zipped(benchmark::State& state) {
+	voice_table<BlockSize> table;
+	fill(table, visit_rows);
+	for (auto _ : state) {
+		table.template visit_spans<position, velocity>(ent::lock, [](size_t, ent::span<position> p, ent::span<velocity> v) {
+			for (size_t i = 0; i < p.size(); ++i) {
+				p[i].value += v[i].value;
+			}
+		});
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * visit_rows * (sizeof(position) + sizeof(velocity)));
+}
+BENCHMARK_TEMPLATE(visit_spans_zipped, 64);
+BENCHMARK_TEMPLATE(visit_spans_zipped, 512);
+BENCHMARK_TEMPLATE(visit_spans_zipped, 4096);
+
+// Column size: the same scan over one column of tables with wider rows.
+template <typename Column>
+static void visit_column_size(benchmark::State& state) {
+	ent::table<512, small_col, medium_col, large_col, gain> table;
+	for (size_t i = 0; i < visit_rows; ++i) {
+		(void)table.acquire(ent::lock);
+	}
+	for (auto _ : state) {
+		table.template visit<Column>(ent::lock, [](size_t, Column& c) { c.values[0] += 1.0f; });
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * visit_rows * sizeof(Column));
+}
+BENCHMARK_TEMPLATE(visit_column_size, small_col);
+BENCHMARK_TEMPLATE(visit_column_size, medium_col);
+BENCHMARK_TEMPLATE(visit_column_size, large_col);
+
+// Occupancy: visit vs visit_active at different fill levels.
+static void visit_occupancy(benchmark::State& state) {
+	voice_table<512> table;
+	fill_sparse(table, visit_rows, static_cast<int>(state.range(0)));
+	for (auto _ : state) {
+		table.visit<gain>(ent::lock, [](size_t, gain& g) { g.value += 1.0f; });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * visit_rows);
+}
+BENCHMARK(visit_occupancy)->Arg(10)->Arg(50)->Arg(100);
+
+static void visit_active_occupancy(benchmark::State& state) {
+	voice_table<512> table;
+	fill_sparse(table, visit_rows, static_cast<int>(state.range(0)));
+	for (auto _ : state) {
+		table.visit_active<gain>(ent::lock, [](size_t, gain& g) { g.value += 1.0f; });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * visit_rows);
+}
+BENCHMARK(visit_active_occupancy)->Arg(10)->Arg(50)->Arg(100);
+
+static void parallel_visit_threads(benchmark::State& state) {
+	voice_table<4096> table;
+	fill(table, visit_rows * 4);
+	ent::thread_pool pool{static_cast<size_t>(state.range(0))};
+	for (auto _ : state) {
+		table.parallel_visit<position, velocity>(ent::lock, pool, [](size_t, position& p, velocity& v) { p.value += v.value; });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * visit_rows * 4);
+}
+BENCHMARK(parallel_visit_threads)->Arg(0)->Arg(1)->Arg(3)->Arg(7)->UseRealTime();
+
+//------------------------------------------------------------------------------
+// find: a predicate scan vs the vectorized kernel, looking for the last row.
+//------------------------------------------------------------------------------
+
+using id_table = ent::table<512, int, float>;
+
+static void find_predicate(benchmark::State& state) {
+	id_table table;
+	for (size_t i = 0; i < visit_rows; ++i) {
+		table.set(table.acquire(ent::lock), static_cast<int>(i));
+	}
+	const auto id = static_cast<int>(visit_rows - 1);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(table.find<int>(ent::lock, [id](int value) { return value == id; }));
+	}
+	state.SetItemsProcessed(state.iterations() * visit_rows);
+}
+BENCHMARK(find_predicate);
+
+static void find_vectorized(benchmark::State& state) {
+	id_table table;
+	for (size_t i = 0; i < visit_rows; ++i) {
+		table.set(table.acquire(ent::lock), static_cast<int>(i));
+	}
+	const auto id = static_cast<int>(visit_rows - 1);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(table.find<int>(ent::lock, ent::cmp::eq, id));
+	}
+	state.SetItemsProcessed(state.iterations() * visit_rows);
+}
+BENCHMARK(find_vectorized);
+
+//------------------------------------------------------------------------------
+// Baselines
+//------------------------------------------------------------------------------
+
+static void baseline_vector_soa(benchmark::State& state) {
+	std::vector<position> positions(visit_rows);
+	std::vector<velocity> velocities(visit_rows);
+	for (auto _ : state) {
+		for (size_t i = 0; i < visit_rows; ++i) {
+			positions[i].value += velocities[i].value;
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * visit_rows * (sizeof(position) + sizeof(velocity)));
+}
+BENCHMARK(baseline_vector_soa);
+
+static void baseline_deque(benchmark::State& state) {
+	std::deque<position> positions(visit_rows);
+	std::deque<velocity> velocities(visit_rows);
+	for (auto _ : state) {
+		for (size_t i = 0; i < visit_rows; ++i) {
+			positions[i].value += velocities[i].value;
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * visit_rows * (sizeof(position) + sizeof(velocity)));
+}
+BENCHMARK(baseline_deque);
+
+BENCHMARK_MAIN();
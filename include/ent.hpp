@@ -4,273 +4,3975 @@
 #include <array>
 #include <atomic>
 #include <bitset>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <numeric>
 #include <optional>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if !defined(ENT_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ENT_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENT_SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ENT_SIMD_NEON 1
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ENT_HAS_MMAP 1
+#endif
+
 namespace ent {
 
 struct lock_t{};
 static constexpr auto lock = lock_t{};
 
-template <size_t BlockSize, typename... Ts>
-struct table {
-	using const_row_t = std::tuple<const Ts&...>;
-	using row_t       = std::tuple<Ts&...>;
+// True if a T with every byte set to zero is the same as T{}. Columns of these
+// types are reset with memset instead of one element at a time. This is
+// detected automatically for trivial types, and you can specialize it for your
+// own types, e.g. a struct whose only member is `int value = 0;`
+template <typename T>
+struct is_zero_initializable
+	: std::bool_constant<std::is_trivially_default_constructible_v<T> && std::is_trivially_copyable_v<T> && !std::is_member_pointer_v<T>>
+{};
+template <typename T>
+static constexpr bool is_zero_initializable_v = is_zero_initializable<T>::value;
+
+namespace detail {
+
+using word_t = uint64_t;
+static constexpr size_t word_bits = 64;
+
+[[nodiscard]] inline
+auto ctz(word_t x) -> size_t {
+#if defined(_MSC_VER)
+	unsigned long result;
+	_BitScanForward64(&result, x);
+	return result;
+#else
+	return static_cast<size_t>(__builtin_ctzll(x));
+#endif
+}
+
+template <typename T, typename... Us>
+struct index_of;
+template <typename T, typename... Us>
+struct index_of<T, T, Us...> : std::integral_constant<size_t, 0> {};
+template <typename T, typename U, typename... Us>
+struct index_of<T, U, Us...> : std::integral_constant<size_t, 1 + index_of<T, Us...>::value> {};
+template <typename T, typename... Us>
+static constexpr size_t count_of = (size_t{std::is_same_v<T, Us>} + ... + 0);
+
+[[nodiscard]] inline
+auto popcount(word_t x) -> size_t {
+#if defined(_MSC_VER)
+	return static_cast<size_t>(__popcnt64(x));
+#else
+	return static_cast<size_t>(__builtin_popcountll(x));
+#endif
+}
+
+// Index of the highest set bit. x must not be zero.
+[[nodiscard]] inline
+auto highest_bit(word_t x) -> size_t {
+#if defined(_MSC_VER)
+	unsigned long result;
+	_BitScanReverse64(&result, x);
+	return result;
+#else
+	return static_cast<size_t>(63 - __builtin_clzll(x));
+#endif
+}
+
+// Resets count consecutive values to T{}. Zero-initializable types are cleared
+// with memset instead of assigning one element at a time.
+template <typename T>
+auto reset_values(T* first, size_t count) -> void {
+	if constexpr (is_zero_initializable_v<T>) {
+		std::memset(static_cast<void*>(first), 0, count * sizeof(T));
+	}
+	else {
+		std::fill_n(first, count, T{});
+	}
+}
+
+} // detail
+
+// Comparisons for the vectorized queries (table::find, count_if, find_all.)
+enum class cmp { eq, ne, lt, le, gt, ge };
+
+namespace detail {
+
+// Kernels for scanning arithmetic columns. Columns of 32-bit floats, integers
+// and enums are processed with SIMD instructions when the target supports
+// them (whatever the compiler was told it could use: AVX2, SSE2, or NEON on
+// AArch64), and everything else falls back to scalar loops. Define ENT_NO_SIMD
+// to always use the scalar loops.
+template <typename T, bool = std::is_enum_v<T>> struct integer_of { using type = T; };
+template <typename T> struct integer_of<T, true> { using type = std::underlying_type_t<T>; };
+
+// The SIMD lane type which can hold a T, or void.
+template <typename T, typename = void>
+struct simd_lane { using type = void; };
+template <>
+struct simd_lane<float> { using type = float; };
+template <typename T>
+struct simd_lane<T, std::enable_if_t<(std::is_integral_v<T> || std::is_enum_v<T>) && !std::is_same_v<T, bool> && sizeof(T) == 4>> {
+	using type = std::conditional_t<std::is_signed_v<typename integer_of<T>::type>, int32_t, uint32_t>;
+};
+template <typename T>
+using simd_lane_t = typename simd_lane<T>::type;
+
+template <cmp Op, typename T> [[nodiscard]] constexpr
+auto compare(const T& a, const T& b) -> bool {
+	if constexpr (Op == cmp::eq) { return a == b; }
+	if constexpr (Op == cmp::ne) { return a != b; }
+	if constexpr (Op == cmp::lt) { return a < b; }
+	if constexpr (Op == cmp::le) { return a <= b; }
+	if constexpr (Op == cmp::gt) { return a > b; }
+	if constexpr (Op == cmp::ge) { return a >= b; }
+}
+
+// simd<Lane> wraps the instructions for one lane type. Every specialization
+// has the same members: load() (unaligned, and the pointer may point at a
+// different type of the same size, e.g. an enum), set1(), add(), min(), max(),
+// store(), and compare<Op>() which returns one bit per lane.
+template <typename Lane>
+struct simd;
+
+#if ENT_SIMD_AVX2
+static constexpr bool has_simd = true;
+template <>
+struct simd<float> {
+	using reg = __m256;
+	static constexpr size_t lanes = 8;
+	[[nodiscard]] static auto load(const void* p) -> reg { return _mm256_loadu_ps(static_cast<const float*>(p)); }
+	[[nodiscard]] static auto set1(float v) -> reg      { return _mm256_set1_ps(v); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return _mm256_add_ps(a, b); }
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { return _mm256_min_ps(a, b); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { return _mm256_max_ps(a, b); }
+	static auto store(float* out, reg a) -> void        { _mm256_storeu_ps(out, a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		if constexpr (Op == cmp::eq) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))); }
+		if constexpr (Op == cmp::ne) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ))); }
+		if constexpr (Op == cmp::lt) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))); }
+		if constexpr (Op == cmp::le) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))); }
+		if constexpr (Op == cmp::gt) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))); }
+		if constexpr (Op == cmp::ge) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))); }
+	}
+};
+template <>
+struct simd<int32_t> {
+	using reg = __m256i;
+	static constexpr size_t lanes = 8;
+	[[nodiscard]] static auto load(const void* p) -> reg { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+	[[nodiscard]] static auto set1(int32_t v) -> reg    { return _mm256_set1_epi32(v); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return _mm256_add_epi32(a, b); }
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { return _mm256_min_epi32(a, b); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { return _mm256_max_epi32(a, b); }
+	static auto store(int32_t* out, reg a) -> void      { _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		const auto bits = [](reg m) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m))); };
+		if constexpr (Op == cmp::eq) { return bits(_mm256_cmpeq_epi32(a, b)); }
+		if constexpr (Op == cmp::ne) { return ~bits(_mm256_cmpeq_epi32(a, b)) & 0xFFu; }
+		if constexpr (Op == cmp::lt) { return bits(_mm256_cmpgt_epi32(b, a)); }
+		if constexpr (Op == cmp::le) { return ~bits(_mm256_cmpgt_epi32(a, b)) & 0xFFu; }
+		if constexpr (Op == cmp::gt) { return bits(_mm256_cmpgt_epi32(a, b)); }
+		if constexpr (Op == cmp::ge) { return ~bits(_mm256_cmpgt_epi32(b, a)) & 0xFFu; }
+	}
+};
+#elif ENT_SIMD_SSE2
+static constexpr bool has_simd = true;
+template <>
+struct simd<float> {
+	using reg = __m128;
+	static constexpr size_t lanes = 4;
+	[[nodiscard]] static auto load(const void* p) -> reg { return _mm_loadu_ps(static_cast<const float*>(p)); }
+	[[nodiscard]] static auto set1(float v) -> reg      { return _mm_set1_ps(v); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return _mm_add_ps(a, b); }
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { return _mm_min_ps(a, b); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { return _mm_max_ps(a, b); }
+	static auto store(float* out, reg a) -> void        { _mm_storeu_ps(out, a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		if constexpr (Op == cmp::eq) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpeq_ps(a, b))); }
+		if constexpr (Op == cmp::ne) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpneq_ps(a, b))); }
+		if constexpr (Op == cmp::lt) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(a, b))); }
+		if constexpr (Op == cmp::le) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(a, b))); }
+		if constexpr (Op == cmp::gt) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpgt_ps(a, b))); }
+		if constexpr (Op == cmp::ge) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpge_ps(a, b))); }
+	}
+};
+template <>
+struct simd<int32_t> {
+	using reg = __m128i;
+	static constexpr size_t lanes = 4;
+	[[nodiscard]] static auto load(const void* p) -> reg { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+	[[nodiscard]] static auto set1(int32_t v) -> reg    { return _mm_set1_epi32(v); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return _mm_add_epi32(a, b); }
+	// SSE2 doesn't have 32-bit integer min and max, so select with a compare.
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { const auto gt = _mm_cmpgt_epi32(a, b); return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a)); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { const auto gt = _mm_cmpgt_epi32(a, b); return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b)); }
+	static auto store(int32_t* out, reg a) -> void      { _mm_storeu_si128(reinterpret_cast<__m128i*>(out), a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		const auto bits = [](reg m) { return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m))); };
+		if constexpr (Op == cmp::eq) { return bits(_mm_cmpeq_epi32(a, b)); }
+		if constexpr (Op == cmp::ne) { return ~bits(_mm_cmpeq_epi32(a, b)) & 0xFu; }
+		if constexpr (Op == cmp::lt) { return bits(_mm_cmplt_epi32(a, b)); }
+		if constexpr (Op == cmp::le) { return ~bits(_mm_cmpgt_epi32(a, b)) & 0xFu; }
+		if constexpr (Op == cmp::gt) { return bits(_mm_cmpgt_epi32(a, b)); }
+		if constexpr (Op == cmp::ge) { return ~bits(_mm_cmplt_epi32(a, b)) & 0xFu; }
+	}
+};
+#elif ENT_SIMD_NEON
+static constexpr bool has_simd = true;
+[[nodiscard]] inline
+auto neon_bits(uint32x4_t m) -> unsigned {
+	static constexpr uint32_t weights[4] = {1, 2, 4, 8};
+	return vaddvq_u32(vandq_u32(m, vld1q_u32(weights)));
+}
+template <>
+struct simd<float> {
+	using reg = float32x4_t;
+	static constexpr size_t lanes = 4;
+	[[nodiscard]] static auto load(const void* p) -> reg { return vld1q_f32(static_cast<const float*>(p)); }
+	[[nodiscard]] static auto set1(float v) -> reg      { return vdupq_n_f32(v); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return vaddq_f32(a, b); }
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { return vminq_f32(a, b); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { return vmaxq_f32(a, b); }
+	static auto store(float* out, reg a) -> void        { vst1q_f32(out, a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		if constexpr (Op == cmp::eq) { return neon_bits(vceqq_f32(a, b)); }
+		if constexpr (Op == cmp::ne) { return neon_bits(vmvnq_u32(vceqq_f32(a, b))); }
+		if constexpr (Op == cmp::lt) { return neon_bits(vcltq_f32(a, b)); }
+		if constexpr (Op == cmp::le) { return neon_bits(vcleq_f32(a, b)); }
+		if constexpr (Op == cmp::gt) { return neon_bits(vcgtq_f32(a, b)); }
+		if constexpr (Op == cmp::ge) { return neon_bits(vcgeq_f32(a, b)); }
+	}
+};
+template <>
+struct simd<int32_t> {
+	using reg = int32x4_t;
+	static constexpr size_t lanes = 4;
+	[[nodiscard]] static auto load(const void* p) -> reg { return vld1q_s32(static_cast<const int32_t*>(p)); }
+	[[nodiscard]] static auto set1(int32_t v) -> reg    { return vdupq_n_s32(v); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return vaddq_s32(a, b); }
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { return vminq_s32(a, b); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { return vmaxq_s32(a, b); }
+	static auto store(int32_t* out, reg a) -> void      { vst1q_s32(out, a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		if constexpr (Op == cmp::eq) { return neon_bits(vceqq_s32(a, b)); }
+		if constexpr (Op == cmp::ne) { return neon_bits(vmvnq_u32(vceqq_s32(a, b))); }
+		if constexpr (Op == cmp::lt) { return neon_bits(vcltq_s32(a, b)); }
+		if constexpr (Op == cmp::le) { return neon_bits(vcleq_s32(a, b)); }
+		if constexpr (Op == cmp::gt) { return neon_bits(vcgtq_s32(a, b)); }
+		if constexpr (Op == cmp::ge) { return neon_bits(vcgeq_s32(a, b)); }
+	}
+};
+#else
+static constexpr bool has_simd = false;
+#endif
+
+#if ENT_SIMD_AVX2 || ENT_SIMD_SSE2 || ENT_SIMD_NEON
+// Unsigned lanes are handled as signed lanes with the sign bit flipped, which
+// maps unsigned order onto signed order. Addition is the same either way.
+template <>
+struct simd<uint32_t> {
+	using base = simd<int32_t>;
+	using reg  = typename base::reg;
+	static constexpr size_t lanes = base::lanes;
+	[[nodiscard]] static auto load(const void* p) -> reg { return base::load(p); }
+	[[nodiscard]] static auto set1(uint32_t v) -> reg   { return base::set1(static_cast<int32_t>(v)); }
+	[[nodiscard]] static auto add(reg a, reg b) -> reg  { return base::add(a, b); }
+	[[nodiscard]] static auto min(reg a, reg b) -> reg  { return flip(base::min(flip(a), flip(b))); }
+	[[nodiscard]] static auto max(reg a, reg b) -> reg  { return flip(base::max(flip(a), flip(b))); }
+	static auto store(uint32_t* out, reg a) -> void     { base::store(reinterpret_cast<int32_t*>(out), a); }
+	template <cmp Op> [[nodiscard]] static
+	auto compare(reg a, reg b) -> unsigned {
+		if constexpr (Op == cmp::eq || Op == cmp::ne) { return base::compare<Op>(a, b); }
+		else                                          { return base::compare<Op>(flip(a), flip(b)); }
+	}
 private:
-	struct block_index { size_t value; };
-	struct sub_index   { size_t value; };
-	struct lookup_t {
-		block_index block;
-		sub_index   sub;
+	[[nodiscard]] static
+	auto flip(reg a) -> reg {
+		// Adding the sign bit flips it without touching the other bits.
+		return base::add(a, base::set1(std::numeric_limits<int32_t>::min()));
+	}
+};
+#endif
+
+// Returns a word with bit i set if (data[i] Op value), for i < count (which
+// must be at most 64.)
+template <cmp Op, typename T> [[nodiscard]]
+auto compare_word(const T* data, size_t count, const T& value) -> word_t {
+	auto bits = word_t{0};
+	auto i    = size_t{0};
+	if constexpr (has_simd && !std::is_void_v<simd_lane_t<T>>) {
+		using lane_t = simd_lane_t<T>;
+		using ops    = simd<lane_t>;
+		const auto v = ops::set1(static_cast<lane_t>(value));
+		for (; i + ops::lanes <= count; i += ops::lanes) {
+			bits |= word_t{ops::template compare<Op>(ops::load(data + i), v)} << i;
+		}
+	}
+	for (; i < count; ++i) {
+		bits |= word_t{compare<Op>(data[i], value)} << i;
+	}
+	return bits;
+}
+
+// Calls fn.template operator()<Op>() with the comparison as a template
+// argument so that the kernels have no branches on it.
+template <typename Fn>
+auto dispatch(cmp op, Fn&& fn) -> decltype(auto) {
+	switch (op) {
+		case cmp::ne: return fn(std::integral_constant<cmp, cmp::ne>{});
+		case cmp::lt: return fn(std::integral_constant<cmp, cmp::lt>{});
+		case cmp::le: return fn(std::integral_constant<cmp, cmp::le>{});
+		case cmp::gt: return fn(std::integral_constant<cmp, cmp::gt>{});
+		case cmp::ge: return fn(std::integral_constant<cmp, cmp::ge>{});
+		default:      return fn(std::integral_constant<cmp, cmp::eq>{});
+	}
+}
+
+enum class reduction { sum, min, max };
+
+template <reduction R, typename T> [[nodiscard]] constexpr
+auto combine(const T& a, const T& b) -> T {
+	if constexpr (R == reduction::sum) { return a + b; }
+	if constexpr (R == reduction::min) { return b < a ? b : a; }
+	if constexpr (R == reduction::max) { return a < b ? b : a; }
+}
+
+// Folds count values into acc. For min and max, acc must already be one of
+// the values (or some other starting point like the first value.)
+template <reduction R, typename T> [[nodiscard]]
+auto reduce_run(const T* data, size_t count, T acc) -> T {
+	auto i = size_t{0};
+	if constexpr (has_simd && std::is_arithmetic_v<T> && !std::is_void_v<simd_lane_t<T>>) {
+		using lane_t = simd_lane_t<T>;
+		using ops    = simd<lane_t>;
+		if (count >= ops::lanes * 2) {
+			auto r = ops::load(data);
+			for (i = ops::lanes; i + ops::lanes <= count; i += ops::lanes) {
+				const auto v = ops::load(data + i);
+				if constexpr (R == reduction::sum) { r = ops::add(r, v); }
+				if constexpr (R == reduction::min) { r = ops::min(r, v); }
+				if constexpr (R == reduction::max) { r = ops::max(r, v); }
+			}
+			lane_t lanes[ops::lanes];
+			ops::store(lanes, r);
+			for (const auto lane : lanes) {
+				acc = combine<R>(acc, static_cast<T>(lane));
+			}
+		}
+	}
+	for (; i < count; ++i) {
+		acc = combine<R>(acc, data[i]);
+	}
+	return acc;
+}
+
+} // detail
+
+// The size of a cache line on the platforms we care about. This is used
+// instead of std::hardware_destructive_interference_size because that isn't
+// available everywhere (and GCC warns about using it in headers.)
+static constexpr size_t cache_line_size = 64;
+
+// Column policies.
+// A column of a table can be declared with one of these wrappers instead of its
+// plain type to change how the column is stored. The column is still accessed
+// through its plain type, e.g.
+//   ent::table<512, ent::aligned<Position>, Gain> table;
+//   table.get<Position>(idx);
+
+// The column array will start on an Alignment-byte boundary in every block.
+// Because the size of the storage is rounded up to its alignment, the column
+// also ends on a boundary. With the default (a cache line) this means that no
+// other column or bookkeeping data of the block shares a cache line with this
+// column, so threads writing to it won't cause false sharing with threads
+// working on neighbouring columns. Use 16/32 if you only care about SIMD loads.
+template <typename T, size_t Alignment = cache_line_size>
+struct aligned {};
+
+// Every block keeps a bitmap of the rows of this column which have changed.
+// Rows are marked by set<T>(), by mark_dirty<T>() (call this after writing
+// through a reference from get<T>()), and whenever the row is reset by
+// release(), clear() or compact(). consume_dirty<T>() visits the marked rows
+// and clears their bits, so something like a UI mirror can copy only what
+// changed since last time.
+template <typename T>
+struct tracked {};
+
+// The column gets three extra copies of its values in every block, which are
+// used as a triple buffer between one writer thread and one reader thread.
+// The writer reads and writes the column as usual, then calls commit() to
+// publish a snapshot of it. The reader calls read_committed() to get a view
+// of the latest snapshot, which won't change while the reader holds on to it
+// and is never torn, without taking any locks.
+template <typename T>
+struct buffered {};
+
+// The table keeps a hash index from the values of this column to the rows
+// holding them, so find_by<T>(value) is O(1) instead of a scan. A row is
+// indexed when its value is set with set(ent::lock, ...) (or reindex<T>() is
+// called after writing through a reference from get<T>()), and it is removed
+// from the index by release(ent::lock, ...), release_n() and clear(). The
+// value type needs std::hash and operator==.
+template <typename T>
+struct indexed {};
+
+// The table keeps the rows of this column sorted by value, so
+// visit_in_range<T>(ent::lock, lo, hi, fn) can visit the rows whose values
+// are in [lo, hi) in order without looking at any others. It is kept up to
+// date in the same places as ent::indexed. The value type needs operator<.
+template <typename T>
+struct ordered {};
+
+// Layout policy.
+// Instead of one array per column, the columns of a group are stored together
+// as one array of interleaved rows in each block, e.g.
+//   ent::table<512, ent::group<Position, Velocity, Gain>, Name> table;
+// stores Position, Velocity and Gain side by side for each row, and Name in
+// its own array. This is better for loops which always read the same few
+// small columns of each row together, because they only touch one stream of
+// cache lines instead of one per column. Grouped columns are still accessed
+// individually through get<T>(), visit<Ts...>() and so on, but because they
+// aren't contiguous they can't be used with the span functions. The columns
+// of a group must be plain types (no other policies.)
+template <typename... Ts>
+struct group {};
+
+namespace detail {
+
+template <typename Column>
+struct column_traits {
+	using value_type = Column;
+	static constexpr size_t alignment = alignof(Column);
+	static constexpr bool   tracked   = false;
+	static constexpr bool   buffered  = false;
+	static constexpr bool   indexed   = false;
+	static constexpr bool   ordered   = false;
+	static constexpr bool   grouped   = false;
+};
+
+template <typename T, size_t Alignment>
+struct column_traits<aligned<T, Alignment>> : column_traits<T> {
+	static_assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+	static constexpr size_t alignment = std::max(Alignment, column_traits<T>::alignment);
+};
+
+template <typename T>
+struct column_traits<tracked<T>> : column_traits<T> {
+	static constexpr bool tracked = true;
+};
+
+template <typename T>
+struct column_traits<buffered<T>> : column_traits<T> {
+	static constexpr bool buffered = true;
+};
+
+template <typename T>
+struct column_traits<indexed<T>> : column_traits<T> {
+	static constexpr bool indexed = true;
+};
+
+template <typename T>
+struct column_traits<ordered<T>> : column_traits<T> {
+	static constexpr bool ordered = true;
+};
+
+// Column I of a group. ent::table expands every group into one of these for
+// each of its columns. The first column of the group holds the storage for the
+// whole group.
+template <typename Group, size_t I>
+struct group_member {};
+
+template <typename... Ts, size_t I>
+struct column_traits<group_member<group<Ts...>, I>> : column_traits<std::tuple_element_t<I, std::tuple<Ts...>>> {
+	using group_row_t                  = std::tuple<Ts...>;
+	using first_type                   = std::tuple_element_t<0, std::tuple<Ts...>>;
+	static constexpr size_t member     = I;
+	static constexpr bool   grouped    = true;
+	static constexpr bool   zero_group = (is_zero_initializable_v<Ts> && ...);
+};
+
+template <typename Column>
+using column_value_t = typename column_traits<Column>::value_type;
+
+// Indexing one column of an array of interleaved rows.
+template <typename Row, size_t I>
+struct member_ptr {
+	Row* rows;
+	[[nodiscard]] auto operator[](size_t index) const -> decltype(auto) { return std::get<I>(rows[index]); }
+};
+
+template <size_t BlockSize>
+using bitmap_t = std::array<std::atomic<word_t>, (BlockSize + word_bits - 1) / word_bits>;
+
+// The optional parts of a column's storage are empty base classes unless the
+// column asked for them.
+template <size_t BlockSize, bool Tracked>
+struct dirty_storage {};
+template <size_t BlockSize>
+struct dirty_storage<BlockSize, true> {
+	bitmap_t<BlockSize> dirty = {};
+};
+
+template <typename T, size_t BlockSize, bool Buffered>
+struct snapshot_storage {};
+template <typename T, size_t BlockSize>
+struct snapshot_storage<T, BlockSize, true> {
+	std::array<std::array<T, BlockSize>, 3> snapshots = {};
+};
+
+template <typename Column, size_t BlockSize, bool Grouped = column_traits<Column>::grouped>
+struct column_storage
+	: dirty_storage<BlockSize, column_traits<Column>::tracked>
+	, snapshot_storage<column_value_t<Column>, BlockSize, column_traits<Column>::buffered>
+{
+	alignas(column_traits<Column>::alignment) std::array<column_value_t<Column>, BlockSize> values;
+};
+
+template <typename Column, size_t BlockSize>
+struct column_storage<Column, BlockSize, true> {
+	using row_t = typename column_traits<Column>::group_row_t;
+	struct empty {};
+	std::conditional_t<column_traits<Column>::member == 0, std::array<row_t, BlockSize>, empty> rows;
+};
+
+template <typename... Columns>
+struct column_list {};
+
+template <typename Column>
+struct expand_column { using type = column_list<Column>; };
+template <typename Group, typename Indices>
+struct expand_group;
+template <typename... Ts, size_t... Is>
+struct expand_group<group<Ts...>, std::index_sequence<Is...>> {
+	static_assert(sizeof...(Ts) > 0, "A group must have at least one column");
+	static_assert((std::is_same_v<column_value_t<Ts>, Ts> && ...), "The columns of a group must be plain types");
+	using type = column_list<group_member<group<Ts...>, Is>...>;
+};
+template <typename... Ts>
+struct expand_column<group<Ts...>> : expand_group<group<Ts...>, std::index_sequence_for<Ts...>> {};
+
+template <typename... Lists>
+struct concat_columns { using type = column_list<>; };
+template <typename... As>
+struct concat_columns<column_list<As...>> { using type = column_list<As...>; };
+template <typename... As, typename... Bs, typename... Lists>
+struct concat_columns<column_list<As...>, column_list<Bs...>, Lists...> : concat_columns<column_list<As..., Bs...>, Lists...> {};
+
+template <template <size_t, typename...> typename Table, size_t BlockSize, typename List>
+struct apply_columns;
+template <template <size_t, typename...> typename Table, size_t BlockSize, typename... Columns>
+struct apply_columns<Table, BlockSize, column_list<Columns...>> { using type = Table<BlockSize, Columns...>; };
+
+// An open addressing hash table from the values of an indexed column to row
+// indices. Only the table's lock holder writes to it, but find() can be called
+// from any thread without a lock. Inserting and erasing are done in place with
+// atomic stores. When the slots have to be rebuilt (to grow, or to get rid of
+// tombstones) they are rebuilt into the second slot array, which no reader is
+// using, and then that one is published. Readers announce themselves with a
+// counter on the array they are reading, and the writer waits for the
+// counter to drop to zero before reusing an array.
+// Each entry holds the row index and the upper half of the hash of the value
+// it was indexed with, so a reader only looks at rows which (almost certainly)
+// held the value it is looking for. Entries are only hints: the table checks
+// that the row is still acquired and still holds the value before returning
+// it, so an entry which has gone stale (e.g. because the row was released
+// without the lock) is harmless. Stale entries are dropped when the slots are
+// next rebuilt.
+template <typename T>
+struct hash_index {
+	hash_index() = default;
+	hash_index(hash_index&& other) noexcept { *this = std::move(other); }
+	hash_index& operator=(hash_index&& other) noexcept {
+		for (size_t i = 0; i < 2; ++i) {
+			arrays_[i].entries  = std::move(other.arrays_[i].entries);
+			arrays_[i].capacity = std::exchange(other.arrays_[i].capacity, 0);
+		}
+		active_.store(other.active_.load());
+		used_       = std::exchange(other.used_, 0);
+		tombstones_ = std::exchange(other.tombstones_, 0);
+		return *this;
+	}
+	// match(row) must return true if the row is acquired and holds the value.
+	template <typename MatchFn> [[nodiscard]]
+	auto find(const T& value, MatchFn&& match) const -> std::optional<size_t> {
+		const auto h = hash(value);
+		for (;;) {
+			const auto active = active_.load(std::memory_order_seq_cst);
+			const auto& slots = arrays_[active];
+			slots.readers.fetch_add(1, std::memory_order_seq_cst);
+			// If the array is still the active one then the writer can't start
+			// rebuilding into it until we are done.
+			if (active_.load(std::memory_order_seq_cst) == active) {
+				const auto result = probe(slots, h, match);
+				slots.readers.fetch_sub(1, std::memory_order_release);
+				return result;
+			}
+			slots.readers.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+	// value_of(row) must return a pointer to the row's value, or nullptr if the
+	// row is not acquired. It is used to rebuild the slots.
+	template <typename ValueOfFn>
+	auto insert(size_t row, const T& value, ValueOfFn&& value_of) -> void {
+		if (row > max_row) {
+			throw std::out_of_range("Element index too large for an index");
+		}
+		if ((used_ + tombstones_ + 1) * 2 > arrays_[active_.load(std::memory_order_relaxed)].capacity) {
+			auto capacity = min_capacity;
+			while (capacity < (used_ + 1) * 4) {
+				capacity *= 2;
+			}
+			rebuild(capacity, value_of);
+		}
+		place(arrays_[active_.load(std::memory_order_relaxed)], row, hash(value));
+	}
+	auto erase(size_t row, const T& value) -> void {
+		auto& slots = arrays_[active_.load(std::memory_order_relaxed)];
+		if (slots.capacity == 0 || row > max_row) {
+			return;
+		}
+		const auto h     = hash(value);
+		const auto entry = make_entry(row, h);
+		const auto mask  = slots.capacity - 1;
+		for (size_t n = 0, i = h & mask; n < slots.capacity; ++n, i = (i + 1) & mask) {
+			const auto current = slots.entries[i].load(std::memory_order_relaxed);
+			if (current == empty_slot) {
+				return;
+			}
+			if (current == entry) {
+				// A tombstone rather than an empty slot, so that the entries after
+				// this one can still be reached.
+				slots.entries[i].store(tombstone, std::memory_order_release);
+				used_--;
+				tombstones_++;
+				return;
+			}
+		}
+	}
+	auto clear() -> void {
+		auto& slots = arrays_[active_.load(std::memory_order_relaxed)];
+		for (size_t i = 0; i < slots.capacity; ++i) {
+			slots.entries[i].store(empty_slot, std::memory_order_relaxed);
+		}
+		used_       = 0;
+		tombstones_ = 0;
+	}
+private:
+	// The low half of an entry is the row index plus first_row, the high half
+	// is the high half of the value's hash.
+	static constexpr uint64_t empty_slot   = 0;
+	static constexpr uint64_t tombstone    = 1;
+	static constexpr uint64_t first_row    = 2;
+	static constexpr uint64_t max_row      = 0xFFFFFFFF - first_row;
+	static constexpr size_t   min_capacity = 16;
+	struct slots_t {
+		std::unique_ptr<std::atomic<uint64_t>[]> entries;
+		size_t                                   capacity = 0;
+		mutable std::atomic<size_t>              readers  = 0;
 	};
-	template <typename T> using column_t = std::array<T, BlockSize>;
-	struct block_t {
-		using data_t = std::tuple<column_t<Ts>...>;
-		data_t data;
-		block_t* next = nullptr;
+	[[nodiscard]] static
+	auto hash(const T& value) -> uint64_t {
+		// std::hash is the identity for integers on the common implementations,
+		// so the bits are mixed before being used.
+		auto h = static_cast<uint64_t>(std::hash<T>{}(value));
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+	[[nodiscard]] static
+	auto make_entry(size_t row, uint64_t h) -> uint64_t {
+		return (h & 0xFFFFFFFF00000000ull) | (row + first_row);
+	}
+	[[nodiscard]] static
+	auto entry_row(uint64_t entry) -> size_t {
+		return static_cast<size_t>((entry & 0xFFFFFFFF) - first_row);
+	}
+	template <typename MatchFn> [[nodiscard]] static
+	auto probe(const slots_t& slots, uint64_t h, MatchFn& match) -> std::optional<size_t> {
+		if (slots.capacity == 0) {
+			return std::nullopt;
+		}
+		const auto mask = slots.capacity - 1;
+		for (size_t n = 0, i = h & mask; n < slots.capacity; ++n, i = (i + 1) & mask) {
+			// Acquire pairs with the release in place() so that we see the row's
+			// value as it was when it was indexed.
+			const auto entry = slots.entries[i].load(std::memory_order_acquire);
+			if (entry == empty_slot) {
+				break;
+			}
+			if (entry != tombstone && (entry >> 32) == (h >> 32) && match(entry_row(entry))) {
+				return entry_row(entry);
+			}
+		}
+		return std::nullopt;
+	}
+	// Adds an entry unless it is already in the chain.
+	auto place(slots_t& slots, size_t row, uint64_t h) -> void {
+		const auto entry = make_entry(row, h);
+		const auto mask  = slots.capacity - 1;
+		auto target      = slots.capacity;
+		for (size_t n = 0, i = h & mask; n < slots.capacity; ++n, i = (i + 1) & mask) {
+			const auto current = slots.entries[i].load(std::memory_order_relaxed);
+			if (current == entry) {
+				return;
+			}
+			if (current == tombstone && target == slots.capacity) {
+				target = i;
+			}
+			if (current == empty_slot) {
+				if (target == slots.capacity) {
+					target = i;
+				}
+				break;
+			}
+		}
+		if (slots.entries[target].load(std::memory_order_relaxed) == tombstone) {
+			tombstones_--;
+		}
+		slots.entries[target].store(entry, std::memory_order_release);
+		used_++;
+	}
+	template <typename ValueOfFn>
+	auto rebuild(size_t capacity, ValueOfFn& value_of) -> void {
+		const auto active = active_.load(std::memory_order_relaxed);
+		const auto& from  = arrays_[active];
+		auto& to          = arrays_[active ^ 1];
+		// Readers only hold on to an array for one probe.
+		while (to.readers.load(std::memory_order_seq_cst) != 0) {
+			std::this_thread::yield();
+		}
+		if (to.capacity == capacity) {
+			for (size_t i = 0; i < capacity; ++i) {
+				to.entries[i].store(empty_slot, std::memory_order_relaxed);
+			}
+		}
+		else {
+			to.entries  = std::make_unique<std::atomic<uint64_t>[]>(capacity);
+			to.capacity = capacity;
+		}
+		used_       = 0;
+		tombstones_ = 0;
+		for (size_t i = 0; i < from.capacity; ++i) {
+			const auto entry = from.entries[i].load(std::memory_order_relaxed);
+			if (entry == empty_slot || entry == tombstone) {
+				continue;
+			}
+			// The row is rehashed from its current value, which also fixes up
+			// entries for rows written through a reference and reindexed.
+			if (const auto value = value_of(entry_row(entry))) {
+				place(to, entry_row(entry), hash(*value));
+			}
+		}
+		active_.store(active ^ 1, std::memory_order_seq_cst);
+	}
+	std::array<slots_t, 2> arrays_;
+	std::atomic<uint8_t>   active_     = 0;
+	size_t                 used_       = 0;
+	size_t                 tombstones_ = 0;
+};
+
+// The rows of an ordered column sorted by (value, row). New entries go into
+// a small sorted delta buffer which is merged into the main sorted run once it
+// grows past a fraction of it, so inserting costs O(delta) rather than O(n).
+// Erased entries in the main run are only flagged, and are dropped by the next
+// merge. Range queries walk both sorted ranges side by side. Like
+// hash_index, entries are hints which the table checks before using, and
+// stale ones are dropped when merging. Only the lock holder uses this.
+template <typename T>
+struct ordered_index {
+	// value_of(row) must return a pointer to the row's value, or nullptr if the
+	// row is not acquired. It is used when merging.
+	template <typename ValueOfFn>
+	auto insert(size_t row, const T& value, ValueOfFn&& value_of) -> void {
+		const auto entry  = entry_t{value, row};
+		const auto in_run = std::lower_bound(run_.begin(), run_.end(), entry, less);
+		if (in_run != run_.end() && !less(entry, *in_run)) {
+			if (in_run->dead) {
+				in_run->dead = false;
+				dead_--;
+			}
+			return;
+		}
+		const auto in_delta = std::lower_bound(delta_.begin(), delta_.end(), entry, less);
+		if (in_delta != delta_.end() && !less(entry, *in_delta)) {
+			return;
+		}
+		delta_.insert(in_delta, entry);
+		if (delta_.size() > std::max(min_delta, run_.size() / 16) || dead_ > run_.size() / 2) {
+			merge(value_of);
+		}
+	}
+	auto erase(size_t row, const T& value) -> void {
+		const auto entry    = entry_t{value, row};
+		const auto in_delta = std::lower_bound(delta_.begin(), delta_.end(), entry, less);
+		if (in_delta != delta_.end() && !less(entry, *in_delta)) {
+			delta_.erase(in_delta);
+			return;
+		}
+		const auto in_run = std::lower_bound(run_.begin(), run_.end(), entry, less);
+		if (in_run != run_.end() && !less(entry, *in_run) && !in_run->dead) {
+			in_run->dead = true;
+			dead_++;
+		}
+	}
+	auto clear() -> void {
+		run_.clear();
+		delta_.clear();
+		dead_ = 0;
+	}
+	// Calls fn(row, value) for every entry with lo <= value < hi, in order.
+	template <typename Fn>
+	auto visit(const T& lo, const T& hi, Fn&& fn) const -> void {
+		const auto lower = [](const entry_t& entry, const T& value) { return entry.value < value; };
+		auto a           = std::lower_bound(run_.begin(), run_.end(), lo, lower);
+		auto b           = std::lower_bound(delta_.begin(), delta_.end(), lo, lower);
+		const auto a_end = std::lower_bound(a, run_.end(), hi, lower);
+		const auto b_end = std::lower_bound(b, delta_.end(), hi, lower);
+		while (a != a_end || b != b_end) {
+			const auto& entry = (b == b_end || (a != a_end && less(*a, *b))) ? *a++ : *b++;
+			if (!entry.dead) {
+				fn(entry.row, entry.value);
+			}
+		}
+	}
+private:
+	static constexpr size_t min_delta = 64;
+	struct entry_t {
+		T      value;
+		size_t row;
+		bool   dead = false;
 	};
 	[[nodiscard]] static
-	auto get(block_t* block, sub_index idx) -> row_t {
-		return std::apply([idx](auto&... args) {
-			return std::make_tuple(args[idx]...);
-		}, block->data);
+	auto less(const entry_t& a, const entry_t& b) -> bool {
+		if (a.value < b.value) { return true; }
+		if (b.value < a.value) { return false; }
+		return a.row < b.row;
+	}
+	template <typename ValueOfFn>
+	auto merge(ValueOfFn& value_of) -> void {
+		std::vector<entry_t> merged;
+		merged.reserve(run_.size() - dead_ + delta_.size());
+		std::merge(run_.begin(), run_.end(), delta_.begin(), delta_.end(), std::back_inserter(merged), less);
+		merged.erase(std::remove_if(merged.begin(), merged.end(), [&value_of](const entry_t& entry) {
+			if (entry.dead) {
+				return true;
+			}
+			const auto current = value_of(entry.row);
+			return !current || *current < entry.value || entry.value < *current;
+		}), merged.end());
+		run_.swap(merged);
+		delta_.clear();
+		dead_ = 0;
+	}
+	std::vector<entry_t> run_;
+	std::vector<entry_t> delta_;
+	size_t               dead_ = 0;
+};
+
+struct no_index {};
+
+template <typename Column>
+using index_t = std::conditional_t<column_traits<Column>::indexed, hash_index<column_value_t<Column>>, no_index>;
+template <typename Column>
+using ordered_index_t = std::conditional_t<column_traits<Column>::ordered, ordered_index<column_value_t<Column>>, no_index>;
+
+// A bounded lock-free queue which any number of threads can push to and pop
+// from (Dmitry Vyukov's design.) Every cell has a sequence number which says
+// whether it is ready to be written or read on the current lap, so pushing
+// and popping are one CAS each and never allocate. The capacity is rounded
+// up to a power of two.
+template <typename T>
+struct mpmc_ring {
+	explicit mpmc_ring(size_t capacity)
+		: capacity_{round_up(capacity)}
+		, cells_{std::make_unique<cell_t[]>(capacity_)}
+	{
+		for (size_t i = 0; i < capacity_; ++i) {
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	[[nodiscard]]
+	auto try_push(const T& value) -> bool {
+		auto pos = tail_.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell     = cells_[pos & (capacity_ - 1)];
+			const auto seq = cell.sequence.load(std::memory_order_acquire);
+			const auto lap = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+			if (lap == 0) {
+				if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lap < 0) {
+				return false;
+			}
+			else {
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	[[nodiscard]]
+	auto try_pop() -> std::optional<T> {
+		auto pos = head_.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell     = cells_[pos & (capacity_ - 1)];
+			const auto seq = cell.sequence.load(std::memory_order_acquire);
+			const auto lap = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+			if (lap == 0) {
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					const auto value = cell.value;
+					cell.sequence.store(pos + capacity_, std::memory_order_release);
+					return value;
+				}
+			}
+			else if (lap < 0) {
+				return std::nullopt;
+			}
+			else {
+				pos = head_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	[[nodiscard]] auto get_capacity() const -> size_t { return capacity_; }
+private:
+	struct cell_t {
+		std::atomic<size_t> sequence = 0;
+		T                   value    = {};
+	};
+	[[nodiscard]] static
+	auto round_up(size_t capacity) -> size_t {
+		size_t result = 1;
+		while (result < capacity) {
+			result *= 2;
+		}
+		return result;
+	}
+	size_t                                   capacity_;
+	std::unique_ptr<cell_t[]>                cells_;
+	alignas(cache_line_size) std::atomic<size_t> head_ = 0;
+	alignas(cache_line_size) std::atomic<size_t> tail_ = 0;
+};
+
+} // detail
+
+// A minimal non-owning view of a contiguous range of elements (std::span is
+// C++20, and this library only requires C++17.)
+template <typename T>
+struct span {
+	using element_type = T;
+	using value_type   = std::remove_cv_t<T>;
+	span() = default;
+	span(T* data, size_t size) : data_{data}, size_{size} {}
+	[[nodiscard]] auto begin() const -> T*                  { return data_; }
+	[[nodiscard]] auto end() const -> T*                    { return data_ + size_; }
+	[[nodiscard]] auto data() const -> T*                   { return data_; }
+	[[nodiscard]] auto size() const -> size_t               { return size_; }
+	[[nodiscard]] auto empty() const -> bool                { return size_ == 0; }
+	[[nodiscard]] auto operator[](size_t index) const -> T& { return data_[index]; }
+private:
+	T*     data_ = nullptr;
+	size_t size_ = 0;
+};
+
+// A row index paired with the generation of the row when the handle was made.
+// Every row's generation is odd while it is acquired and even while it is free,
+// and is incremented on every acquire and release, so a handle stops being
+// alive as soon as its row is released and never comes back to life even if
+// the same index is acquired again. A default-constructed handle is never
+// alive.
+struct handle {
+	uint64_t value = 0;
+	[[nodiscard]] static
+	auto make(size_t index, uint32_t generation) -> handle {
+		if (index > std::numeric_limits<uint32_t>::max()) {
+			throw std::out_of_range("Element index too large for a handle");
+		}
+		return {(uint64_t{generation} << 32) | index};
+	}
+	[[nodiscard]] auto index() const -> size_t        { return static_cast<size_t>(value & 0xFFFFFFFF); }
+	[[nodiscard]] auto generation() const -> uint32_t { return static_cast<uint32_t>(value >> 32); }
+	friend auto operator==(handle a, handle b) -> bool { return a.value == b.value; }
+	friend auto operator!=(handle a, handle b) -> bool { return a.value != b.value; }
+};
+
+namespace detail {
+// The start of a region formatted by ent::shared_allocator. Offsets are in
+// bytes from the start of the region.
+struct shared_header {
+	static constexpr uint64_t magic_value     = 0x31454c4241544e45; // "ENTABLE1"
+	static constexpr uint32_t current_version = 1;
+	std::atomic<uint64_t> magic       = 0;
+	uint32_t              version     = 0;
+	uint64_t              layout      = 0;
+	uint64_t              block_bytes = 0;
+	uint64_t              max_blocks  = 0;
+	uint64_t              first_block = 0;
+	std::atomic<uint64_t> block_count = 0;
+	std::atomic<uint64_t> epoch       = 0;
+	// Followed by max_blocks std::atomic<uint64_t> block offsets.
+};
+// The start of a file written by save(). The rest of the file is raw column
+// data, in native byte order.
+struct file_header {
+	static constexpr uint64_t magic_value     = 0x31454c4946544e45; // "ENTFILE1"
+	static constexpr uint32_t current_version = 1;
+	static constexpr uint32_t byte_order_mark = 0x01020304;
+	uint64_t magic       = magic_value;
+	uint32_t version     = current_version;
+	uint32_t byte_order  = byte_order_mark;
+	uint64_t layout      = 0;
+	uint64_t block_count = 0;
+	uint64_t row_count   = 0;
+};
+// FNV-1a over a list of sizes, used to tell whether two builds agree on the
+// memory layout of a table.
+[[nodiscard]] constexpr
+auto hash_layout(std::initializer_list<uint64_t> values) -> uint64_t {
+	auto hash = uint64_t{14695981039346656037ULL};
+	for (const auto value : values) {
+		hash = (hash ^ value) * 1099511628211ULL;
+	}
+	return hash;
+}
+[[nodiscard]] inline
+auto read_file_header(ent::span<const std::byte> bytes, uint64_t layout) -> file_header {
+	auto header = file_header{};
+	if (bytes.size() < sizeof(header)) {
+		throw std::runtime_error("Not an ent file");
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (header.magic != file_header::magic_value) {
+		throw std::runtime_error("Not an ent file");
+	}
+	if (header.version != file_header::current_version) {
+		throw std::runtime_error("Unsupported ent file version");
+	}
+	if (header.byte_order != file_header::byte_order_mark) {
+		throw std::runtime_error("ent file has a different byte order");
+	}
+	if (header.layout != layout) {
+		throw std::runtime_error("ent file has different columns");
+	}
+	return header;
+}
+// Throws if the file doesn't have count records of record_size bytes after
+// the header.
+inline
+auto check_file_size(ent::span<const std::byte> bytes, uint64_t count, size_t record_size) -> void {
+	if (record_size > 0 && (bytes.size() - sizeof(file_header)) / record_size < count) {
+		throw std::runtime_error("ent file is truncated");
+	}
+}
+struct file_writer {
+	explicit file_writer(const char* path) : file_{std::fopen(path, "wb")} {
+		if (!file_) {
+			throw std::system_error(errno, std::generic_category(), "fopen");
+		}
+	}
+	file_writer(const file_writer&) = delete;
+	file_writer& operator=(const file_writer&) = delete;
+	~file_writer() {
+		if (file_) {
+			std::fclose(file_);
+		}
+	}
+	auto write(const void* data, size_t size) -> void {
+		if (size > 0 && std::fwrite(data, 1, size, file_) != size) {
+			throw std::system_error(errno, std::generic_category(), "fwrite");
+		}
+	}
+	auto write_header(const file_header& header) -> void {
+		if (std::fseek(file_, 0, SEEK_SET) != 0) {
+			throw std::system_error(errno, std::generic_category(), "fseek");
+		}
+		write(&header, sizeof(header));
+	}
+	auto close() -> void {
+		if (std::fclose(std::exchange(file_, nullptr)) != 0) {
+			throw std::system_error(errno, std::generic_category(), "fclose");
+		}
+	}
+private:
+	std::FILE* file_;
+};
+// A whole file, mapped read-only where that's possible, or read into memory.
+struct mapped_file {
+	explicit mapped_file(const char* path) {
+#if ENT_HAS_MMAP
+		const auto fd = ::open(path, O_RDONLY);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open");
+		}
+		struct stat info = {};
+		if (::fstat(fd, &info) != 0) {
+			const auto error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "fstat");
+		}
+		size_ = static_cast<size_t>(info.st_size);
+		if (size_ > 0) {
+			const auto ptr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (ptr == MAP_FAILED) {
+				const auto error = errno;
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), "mmap");
+			}
+			data_ = static_cast<const std::byte*>(ptr);
+		}
+		::close(fd);
+#else
+		const auto file = std::fopen(path, "rb");
+		if (!file) {
+			throw std::system_error(errno, std::generic_category(), "fopen");
+		}
+		std::byte buffer[65536];
+		while (const auto count = std::fread(buffer, 1, sizeof(buffer), file)) {
+			contents_.insert(contents_.end(), buffer, buffer + count);
+		}
+		std::fclose(file);
+		data_ = contents_.data();
+		size_ = contents_.size();
+#endif
+	}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	~mapped_file() {
+#if ENT_HAS_MMAP
+		if (data_) {
+			::munmap(const_cast<std::byte*>(data_), size_);
+		}
+#endif
+	}
+	[[nodiscard]] auto get_bytes() const -> ent::span<const std::byte> { return {data_, size_}; }
+private:
+	const std::byte*       data_ = nullptr;
+	size_t                 size_ = 0;
+#if !ENT_HAS_MMAP
+	std::vector<std::byte> contents_;
+#endif
+};
+} // detail
+
+// A snapshot of a table's counters, from table::get_stats(). These are only
+// collected if ENT_STATS is defined, otherwise they are all zero. Histogram
+// bucket i counts the samples in [2^i, 2^(i+1)), except that bucket 0 also
+// counts zeros and the last bucket counts everything bigger.
+struct table_stats {
+	static constexpr size_t histogram_buckets = 32;
+	using histogram_t = std::array<uint64_t, histogram_buckets>;
+	uint64_t    acquires            = 0; // Rows acquired
+	uint64_t    releases            = 0; // Rows released (not counting clears)
+	uint64_t    clears              = 0; // Calls to clear() or clear_lazy()
+	uint64_t    failed_try_acquires = 0; // Calls to try_acquire() which found no row
+	uint64_t    blocks_added        = 0; // Blocks linked into the table, new or spare
+	uint64_t    block_allocations   = 0; // Blocks allocated
+	uint64_t    peak_active_rows    = 0; // The highest active row count seen
+	histogram_t search_depth        = {}; // Blocks looked at per row claimed
+	histogram_t lock_wait_ns        = {}; // Time spent waiting for the lock
+	histogram_t lock_hold_ns        = {}; // Time the lock was held for
+};
+
+namespace detail {
+#if defined(ENT_STATS)
+struct stats_counters {
+	using histogram_t = std::array<std::atomic<uint64_t>, table_stats::histogram_buckets>;
+	auto add_acquires(size_t count) -> void        { acquires.fetch_add(count, std::memory_order_relaxed); }
+	auto add_release() -> void                     { releases.fetch_add(1, std::memory_order_relaxed); }
+	auto add_clear() -> void                       { clears.fetch_add(1, std::memory_order_relaxed); }
+	auto add_failed_try_acquire() -> void          { failed_try_acquires.fetch_add(1, std::memory_order_relaxed); }
+	auto add_block() -> void                       { blocks_added.fetch_add(1, std::memory_order_relaxed); }
+	auto add_allocation() -> void                  { block_allocations.fetch_add(1, std::memory_order_relaxed); }
+	auto add_search_depth(size_t blocks) -> void   { record(search_depth, blocks); }
+	auto add_lock_wait(uint64_t ns) -> void        { record(lock_wait_ns, ns); }
+	auto add_lock_hold(uint64_t ns) -> void        { record(lock_hold_ns, ns); }
+	auto update_peak(size_t active) -> void {
+		auto peak = peak_active_rows.load(std::memory_order_relaxed);
+		while (active > peak && !peak_active_rows.compare_exchange_weak(peak, active, std::memory_order_relaxed)) {}
+	}
+	[[nodiscard]]
+	auto get() const -> table_stats {
+		auto result = table_stats{};
+		result.acquires            = acquires.load(std::memory_order_relaxed);
+		result.releases            = releases.load(std::memory_order_relaxed);
+		result.clears              = clears.load(std::memory_order_relaxed);
+		result.failed_try_acquires = failed_try_acquires.load(std::memory_order_relaxed);
+		result.blocks_added        = blocks_added.load(std::memory_order_relaxed);
+		result.block_allocations   = block_allocations.load(std::memory_order_relaxed);
+		result.peak_active_rows    = peak_active_rows.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < table_stats::histogram_buckets; ++i) {
+			result.search_depth[i] = search_depth[i].load(std::memory_order_relaxed);
+			result.lock_wait_ns[i] = lock_wait_ns[i].load(std::memory_order_relaxed);
+			result.lock_hold_ns[i] = lock_hold_ns[i].load(std::memory_order_relaxed);
+		}
+		return result;
+	}
+private:
+	static auto record(histogram_t& histogram, uint64_t value) -> void {
+		const auto bucket = value ? std::min(highest_bit(value), table_stats::histogram_buckets - 1) : 0;
+		histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+	std::atomic<uint64_t> acquires            = 0;
+	std::atomic<uint64_t> releases            = 0;
+	std::atomic<uint64_t> clears              = 0;
+	std::atomic<uint64_t> failed_try_acquires = 0;
+	std::atomic<uint64_t> blocks_added        = 0;
+	std::atomic<uint64_t> block_allocations   = 0;
+	std::atomic<uint64_t> peak_active_rows    = 0;
+	histogram_t           search_depth        = {};
+	histogram_t           lock_wait_ns        = {};
+	histogram_t           lock_hold_ns        = {};
+};
+// Like std::lock_guard, but records how long it waited for the mutex and how
+// long it held it.
+struct timed_lock {
+	timed_lock(std::mutex& mutex, stats_counters& stats) : mutex_{mutex}, stats_{stats} {
+		const auto start = clock::now();
+		mutex_.lock();
+		locked_ = clock::now();
+		stats_.add_lock_wait(nanoseconds(locked_ - start));
+	}
+	timed_lock(const timed_lock&) = delete;
+	timed_lock& operator=(const timed_lock&) = delete;
+	~timed_lock() {
+		stats_.add_lock_hold(nanoseconds(clock::now() - locked_));
+		mutex_.unlock();
+	}
+private:
+	using clock = std::chrono::steady_clock;
+	[[nodiscard]] static
+	auto nanoseconds(clock::duration duration) -> uint64_t {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	}
+	std::mutex&       mutex_;
+	stats_counters&   stats_;
+	clock::time_point locked_;
+};
+#else
+// With ENT_STATS undefined everything compiles away.
+struct stats_counters {
+	auto add_acquires(size_t) -> void       {}
+	auto add_release() -> void              {}
+	auto add_clear() -> void                {}
+	auto add_failed_try_acquire() -> void   {}
+	auto add_block() -> void                {}
+	auto add_allocation() -> void           {}
+	auto add_search_depth(size_t) -> void   {}
+	auto update_peak(size_t) -> void        {}
+	[[nodiscard]] auto get() const -> table_stats { return {}; }
+};
+#endif
+} // detail
+
+// Tables allocate their blocks through one of these. The default allocator
+// uses aligned operator new. You can implement your own to hand out blocks
+// from an arena, from huge pages or from mlock'd memory. The allocator must
+// outlive every table that uses it, and allocate() may be called from any
+// thread which calls a function taking ent::lock_t.
+struct allocator {
+	virtual ~allocator() = default;
+	[[nodiscard]] virtual auto allocate(size_t size, size_t alignment) -> void* = 0;
+	virtual auto deallocate(void* ptr, size_t size, size_t alignment) -> void = 0;
+	// Sets size bytes of memory which was handed out by allocate() to zero. This
+	// is what clear() uses for zero-initializable columns, so an allocator can
+	// override it to do something cheaper than memset.
+	virtual auto zero(void* ptr, size_t size) -> void {
+		std::memset(ptr, 0, size);
+	}
+	// Tables call these with their lock held to say where their blocks are, so
+	// that an allocator whose memory other processes can see (such as
+	// ent::shared_allocator) can tell them. publish_block() is called when a
+	// block is added to a table at this block index, before the table's block
+	// count grows to include it. publish_state() is called whenever the block
+	// count or the table's epoch (see clear_lazy()) changes.
+	virtual auto publish_block(size_t, const void*) -> void {}
+	virtual auto publish_state(size_t, uint64_t) -> void {}
+};
+
+struct new_delete_allocator : allocator {
+	[[nodiscard]]
+	auto allocate(size_t size, size_t alignment) -> void* override {
+		return ::operator new(size, std::align_val_t{alignment});
+	}
+	auto deallocate(void* ptr, size_t, size_t alignment) -> void override {
+		::operator delete(ptr, std::align_val_t{alignment});
+	}
+};
+
+#if ENT_HAS_MMAP
+// Allocates every block with its own anonymous memory mapping. When a large
+// column is zeroed, the whole pages inside it are replaced with fresh zero
+// pages (by mapping over them) instead of being written to, which gives the
+// memory back to the OS until the rows are touched again. This is only worth
+// it for very big blocks; for anything smaller than a handful of pages it
+// behaves like memset.
+struct page_allocator : allocator {
+	[[nodiscard]]
+	auto allocate(size_t size, size_t alignment) -> void* override {
+		if (alignment > page_size()) {
+			throw std::bad_alloc{};
+		}
+		const auto ptr = ::mmap(nullptr, round_up(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED) {
+			throw std::bad_alloc{};
+		}
+		return ptr;
+	}
+	auto deallocate(void* ptr, size_t size, size_t) -> void override {
+		::munmap(ptr, round_up(size));
+	}
+	auto zero(void* ptr, size_t size) -> void override {
+		const auto page  = page_size();
+		const auto begin = reinterpret_cast<uintptr_t>(ptr);
+		const auto end   = begin + size;
+		const auto first = (begin + page - 1) / page * page;
+		const auto last  = end / page * page;
+		if (last <= first || (last - first) < (min_pages * page)) {
+			std::memset(ptr, 0, size);
+			return;
+		}
+		// Replacing the mapping is atomic as far as other threads are concerned:
+		// they see either the old page or a zero page, never an unmapped one.
+		const auto remapped = ::mmap(reinterpret_cast<void*>(first), last - first, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+		if (remapped == MAP_FAILED) {
+			std::memset(reinterpret_cast<void*>(first), 0, last - first);
+		}
+		std::memset(ptr, 0, first - begin);
+		std::memset(reinterpret_cast<void*>(last), 0, end - last);
+	}
+private:
+	static constexpr size_t min_pages = 16;
+	[[nodiscard]] static
+	auto page_size() -> size_t {
+		static const auto size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+		return size;
+	}
+	[[nodiscard]] static
+	auto round_up(size_t size) -> size_t {
+		const auto page = page_size();
+		return (size + page - 1) / page * page;
+	}
+};
+#endif
+
+[[nodiscard]] inline
+auto default_allocator() -> allocator& {
+	static auto instance = new_delete_allocator{};
+	return instance;
+}
+
+// Executors are used by table::parallel_visit. An executor is any object which
+// can be called like this:
+//   executor(task_count, task);
+// It must call task(i) exactly once for every i in [0, task_count), in any
+// order and on any threads, and it must not return until every call has
+// finished. Starting a task and returning from the executor must both
+// synchronize-with the calling thread (which is true of anything built on
+// a mutex, a condition variable, std::thread or std::async.)
+
+// Runs every task on the calling thread.
+struct serial_executor {
+	template <typename Task>
+	auto operator()(size_t task_count, Task&& task) const -> void {
+		for (size_t i = 0; i < task_count; ++i) {
+			task(i);
+		}
+	}
+};
+
+// A fixed set of worker threads. Tasks are not assigned up front; every thread
+// (including the calling thread, which joins in) repeatedly claims the next
+// unstarted task from a shared atomic counter until there are none left, so
+// threads which finish early take work that would otherwise have queued up
+// behind slower ones. Only one batch of tasks runs at a time; concurrent calls
+// are serialized.
+struct thread_pool {
+	explicit thread_pool(size_t thread_count = default_thread_count()) {
+		threads_.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads_.emplace_back([this] { work(); });
+		}
+	}
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+	~thread_pool() {
+		{
+			const auto lock = std::lock_guard{mutex_};
+			stop_ = true;
+		}
+		work_cv_.notify_all();
+		for (auto& thread : threads_) {
+			thread.join();
+		}
+	}
+	[[nodiscard]]
+	auto get_thread_count() const -> size_t {
+		return threads_.size();
+	}
+	template <typename Task>
+	auto operator()(size_t task_count, Task&& task) -> void {
+		if (task_count == 0) {
+			return;
+		}
+		using task_t = std::remove_reference_t<Task>;
+		const auto submit_lock = std::lock_guard{submit_mutex_};
+		job_t job;
+		job.context    = const_cast<void*>(static_cast<const void*>(std::addressof(task)));
+		job.run        = [](void* context, size_t index) { (*static_cast<task_t*>(context))(index); };
+		job.task_count = task_count;
+		{
+			const auto lock = std::lock_guard{mutex_};
+			job_ = &job;
+			generation_++;
+		}
+		work_cv_.notify_all();
+		run(job);
+		auto lock = std::unique_lock{mutex_};
+		job_ = nullptr;
+		done_cv_.wait(lock, [&job] { return job.busy == 0; });
+		if (job.error) {
+			std::rethrow_exception(job.error);
+		}
+	}
+private:
+	struct job_t {
+		void*               context = nullptr;
+		void                (*run)(void*, size_t) = nullptr;
+		size_t              task_count = 0;
+		std::atomic<size_t> next       = 0;
+		size_t              busy       = 0; // Guarded by mutex_
+		std::exception_ptr  error;          // Guarded by mutex_
+	};
+	[[nodiscard]] static
+	auto default_thread_count() -> size_t {
+		// The calling thread also runs tasks.
+		const auto hardware = static_cast<size_t>(std::thread::hardware_concurrency());
+		return hardware > 1 ? hardware - 1 : 0;
+	}
+	auto run(job_t& job) -> void {
+		for (;;) {
+			const auto index = job.next.fetch_add(1, std::memory_order_relaxed);
+			if (index >= job.task_count) {
+				return;
+			}
+			try {
+				job.run(job.context, index);
+			}
+			catch (...) {
+				const auto lock = std::lock_guard{mutex_};
+				if (!job.error) {
+					job.error = std::current_exception();
+				}
+			}
+		}
+	}
+	auto work() -> void {
+		auto lock = std::unique_lock{mutex_};
+		size_t seen_generation = 0;
+		for (;;) {
+			work_cv_.wait(lock, [this, &seen_generation] { return stop_ || (job_ && generation_ != seen_generation); });
+			if (stop_) {
+				return;
+			}
+			seen_generation = generation_;
+			const auto job  = job_;
+			job->busy++;
+			lock.unlock();
+			run(*job);
+			lock.lock();
+			if (--job->busy == 0) {
+				done_cv_.notify_all();
+			}
+		}
+	}
+	std::vector<std::thread> threads_;
+	std::mutex               submit_mutex_;
+	std::mutex               mutex_;
+	std::condition_variable  work_cv_;
+	std::condition_variable  done_cv_;
+	job_t*                   job_        = nullptr;
+	size_t                   generation_ = 0;
+	bool                     stop_       = false;
+};
+
+namespace detail {
+// A random access iterator over [0, size) which calls source(index) to get the
+// element at each index. Forward and random access iterators have to have a
+// real reference type, so when source returns by value (a tuple of references,
+// say) this is a proxy iterator: it still has every random access operator,
+// but it only claims to be an input iterator, and it has no operator->.
+template <typename Source>
+struct index_iterator {
+	using reference         = decltype(std::declval<const Source&>()(size_t{}));
+	using value_type        = std::remove_cv_t<std::remove_reference_t<reference>>;
+	using pointer           = std::conditional_t<std::is_reference_v<reference>, std::add_pointer_t<reference>, void>;
+	using difference_type   = std::ptrdiff_t;
+	using iterator_category = std::conditional_t<std::is_reference_v<reference>, std::random_access_iterator_tag, std::input_iterator_tag>;
+	index_iterator() = default;
+	index_iterator(Source source, size_t index) : source_{source}, index_{index} {}
+	[[nodiscard]] auto operator*() const -> reference                      { return source_(index_); }
+	template <typename R = reference, typename = std::enable_if_t<std::is_reference_v<R>>>
+	[[nodiscard]] auto operator->() const -> pointer                       { return std::addressof(source_(index_)); }
+	[[nodiscard]] auto operator[](difference_type n) const -> reference    { return source_(index_ + n); }
+	auto operator++() -> index_iterator&                                   { ++index_; return *this; }
+	auto operator--() -> index_iterator&                                   { --index_; return *this; }
+	auto operator++(int) -> index_iterator                                 { auto copy = *this; ++index_; return copy; }
+	auto operator--(int) -> index_iterator                                 { auto copy = *this; --index_; return copy; }
+	auto operator+=(difference_type n) -> index_iterator&                  { index_ += n; return *this; }
+	auto operator-=(difference_type n) -> index_iterator&                  { index_ -= n; return *this; }
+	[[nodiscard]] auto operator+(difference_type n) const -> index_iterator { return {source_, index_ + n}; }
+	[[nodiscard]] auto operator-(difference_type n) const -> index_iterator { return {source_, index_ - n}; }
+	[[nodiscard]] friend auto operator+(difference_type n, const index_iterator& it) -> index_iterator { return it + n; }
+	[[nodiscard]] friend auto operator-(const index_iterator& a, const index_iterator& b) -> difference_type {
+		return static_cast<difference_type>(a.index_) - static_cast<difference_type>(b.index_);
+	}
+	[[nodiscard]] friend auto operator==(const index_iterator& a, const index_iterator& b) -> bool { return a.index_ == b.index_; }
+	[[nodiscard]] friend auto operator!=(const index_iterator& a, const index_iterator& b) -> bool { return a.index_ != b.index_; }
+	[[nodiscard]] friend auto operator<(const index_iterator& a, const index_iterator& b) -> bool  { return a.index_ < b.index_; }
+	[[nodiscard]] friend auto operator>(const index_iterator& a, const index_iterator& b) -> bool  { return a.index_ > b.index_; }
+	[[nodiscard]] friend auto operator<=(const index_iterator& a, const index_iterator& b) -> bool { return a.index_ <= b.index_; }
+	[[nodiscard]] friend auto operator>=(const index_iterator& a, const index_iterator& b) -> bool { return a.index_ >= b.index_; }
+	// The index of the element this points at.
+	[[nodiscard]] auto index() const -> size_t { return index_; }
+private:
+	Source source_ = {};
+	size_t index_  = 0;
+};
+template <typename Source>
+struct index_range {
+	using iterator = index_iterator<Source>;
+	[[nodiscard]] auto begin() const -> iterator                              { return {source_, 0}; }
+	[[nodiscard]] auto end() const -> iterator                                { return {source_, size_}; }
+	[[nodiscard]] auto size() const -> size_t                                 { return size_; }
+	[[nodiscard]] auto empty() const -> bool                                  { return size_ == 0; }
+	[[nodiscard]] auto operator[](size_t index) const -> typename iterator::reference { return source_(index); }
+	Source source_;
+	size_t size_;
+};
+} // detail
+
+// A non-owning view of some of the columns of an ent::table, made by
+// table.view<Cs...>(ent::lock). Its type only depends on the block size and
+// the columns it holds, so code which only needs a couple of columns can take
+// an ent::column_view<512, A, B> instead of the whole table type. It holds a
+// copy of the table's block pointers (plus one column pointer per block per
+// column), so every access is resolved at compile time and costs the same
+// as a plain array lookup, and everything is realtime-safe. Visits follow the
+// same rules as the table's own functions of the same name.
+// NOTE: A view only covers the blocks the table had when the view was made,
+// so make a new one if the table grows. It points into the table itself
+// (the occupancy bitmaps and epochs are read live), so it mustn't outlive
+// the table, and it is invalidated by moving the table, and by
+// free_reserved_blocks() (the blocks parked by compact() might be freed.)
+template <size_t BlockSize, typename... Cs>
+struct column_view {
+private:
+	static_assert(((detail::count_of<Cs, Cs...> == 1) && ...), "Column types must be unique");
+	static constexpr size_t word_count = (BlockSize + detail::word_bits - 1) / detail::word_bits;
+	struct block_t {
+		std::tuple<Cs*...>                  columns;
+		const std::atomic<detail::word_t>*  occupied;
+		const std::atomic<uint64_t>*        epoch;
+	};
+	template <typename T>
+	struct column_source {
+		const block_t* blocks = nullptr;
+		auto operator()(size_t idx) const -> T& { return std::get<T*>(blocks[idx / BlockSize].columns)[idx % BlockSize]; }
+	};
+	template <typename... Vs>
+	struct row_source {
+		const block_t* blocks = nullptr;
+		auto operator()(size_t idx) const -> std::tuple<Vs&...> {
+			const auto& block = blocks[idx / BlockSize];
+			return {std::get<Vs*>(block.columns)[idx % BlockSize]...};
+		}
+	};
+public:
+	// The index of a block's first row and a span of each column.
+	using segment = std::tuple<size_t, ent::span<Cs>...>;
+	column_view() = default;
+	[[nodiscard]] auto get_block_count() const -> size_t { return blocks_.size(); }
+	[[nodiscard]] auto get_capacity() const -> size_t    { return blocks_.size() * BlockSize; }
+	template <typename T> [[nodiscard]]
+	auto get(size_t idx) const -> T& {
+		if (idx >= get_capacity()) {
+			throw std::out_of_range("Element index out of range");
+		}
+		return std::get<T*>(blocks_[idx / BlockSize].columns)[idx % BlockSize];
+	}
+	// Calls fn(index, Vs&...) for every row, acquired or not.
+	template <typename... Vs, typename Fn>
+	auto visit(Fn&& fn) const -> void {
+		for (size_t b = 0; b < blocks_.size(); ++b) {
+			const auto& block = blocks_[b];
+			for (size_t i = 0; i < BlockSize; ++i) {
+				fn((b * BlockSize) + i, std::get<Vs*>(block.columns)[i]...);
+			}
+		}
+	}
+	// Calls fn(index, Vs&...) for every acquired row.
+	template <typename... Vs, typename Fn>
+	auto visit_active(Fn&& fn) const -> void {
+		for (size_t b = 0; b < blocks_.size(); ++b) {
+			const auto& block = blocks_[b];
+			if (block.epoch->load(std::memory_order_acquire) != epoch_->load(std::memory_order_acquire)) {
+				continue;
+			}
+			for (size_t w = 0; w < word_count; ++w) {
+				auto bits = block.occupied[w].load(std::memory_order_acquire);
+				while (bits) {
+					const auto sub = (w * detail::word_bits) + detail::ctz(bits);
+					bits &= bits - 1;
+					fn((b * BlockSize) + sub, std::get<Vs*>(block.columns)[sub]...);
+				}
+			}
+		}
+	}
+	// Calls fn(base, ent::span<Vs>...) once per block, like table::visit_spans.
+	template <typename... Vs, typename Fn>
+	auto visit_spans(Fn&& fn) const -> void {
+		static_assert(sizeof...(Vs) > 0, "visit_spans requires at least one column");
+		for (size_t b = 0; b < blocks_.size(); ++b) {
+			fn(b * BlockSize, ent::span<Vs>{std::get<Vs*>(blocks_[b].columns), BlockSize}...);
+		}
+	}
+	// Ranges with random access iterators, for standard algorithms. These
+	// cover every row, acquired or not, just like visit(). column<T>() is a
+	// range of T&, and rows<Vs...>() is a (proxy) range of std::tuple<Vs&...>.
+	// segments() is a span of one segment per block, built when the view was
+	// made, so any algorithm (including the parallel ones) can split the work
+	// across blocks and run a tight (vectorizable) loop within each one:
+	//   const auto segments = view.segments();
+	//   std::for_each(std::execution::par, segments.begin(), segments.end(), [](const auto& segment) {
+	//     auto& [base, positions, velocities] = segment;
+	//     ...
+	//   });
+	template <typename T> [[nodiscard]]
+	auto column() const -> detail::index_range<column_source<T>> {
+		return {{blocks_.data()}, get_capacity()};
+	}
+	template <typename... Vs> [[nodiscard]]
+	auto rows() const -> detail::index_range<row_source<Vs...>> {
+		return {{blocks_.data()}, get_capacity()};
+	}
+	[[nodiscard]]
+	auto segments() const -> ent::span<const segment> {
+		return {segments_.data(), segments_.size()};
+	}
+private:
+	template <size_t, typename...> friend struct basic_table;
+	std::vector<block_t>         blocks_;
+	std::vector<segment>         segments_;
+	const std::atomic<uint64_t>* epoch_ = nullptr;
+};
+
+// This is ent::table with any groups already expanded into their columns.
+// Use ent::table (below) rather than naming this directly.
+template <size_t BlockSize, typename... Ts>
+struct basic_table {
+	using const_row_t = std::tuple<const detail::column_value_t<Ts>&...>;
+	using row_t       = std::tuple<detail::column_value_t<Ts>&...>;
+private:
+	struct block_index { size_t value; };
+	struct sub_index   { size_t value; };
+	struct lookup_t {
+		block_index block;
+		sub_index   sub;
+	};
+	template <typename T> using column_t = std::array<T, BlockSize>;
+	static constexpr size_t word_count = (BlockSize + detail::word_bits - 1) / detail::word_bits;
+	struct block_t {
+		using data_t     = std::tuple<detail::column_storage<Ts, BlockSize>...>;
+		using occupied_t    = detail::bitmap_t<BlockSize>;
+		using generations_t = std::array<std::atomic<uint32_t>, BlockSize>;
+		data_t data;
+		// Kept on its own cache line so that claiming and freeing rows doesn't
+		// cause false sharing with threads working on the last column.
+		alignas(cache_line_size) occupied_t occupied = {};
+		generations_t generations = {};
+		// The table epoch this block was last cleared in. See clear_lazy().
+		std::atomic<uint64_t> epoch = 0;
+	};
+	static constexpr auto refreshing_epoch = std::numeric_limits<uint64_t>::max();
+	template <typename T> static constexpr size_t column_index = detail::index_of<T, detail::column_value_t<Ts>...>::value;
+	template <typename T> using column_traits_t = detail::column_traits<std::tuple_element_t<column_index<T>, std::tuple<Ts...>>>;
+	template <typename T> static constexpr bool is_tracked  = column_traits_t<T>::tracked;
+	template <typename T> static constexpr bool is_buffered = column_traits_t<T>::buffered;
+	template <typename T> static constexpr bool is_indexed  = column_traits_t<T>::indexed;
+	template <typename T> static constexpr bool is_ordered  = column_traits_t<T>::ordered;
+	template <typename T> static constexpr bool is_grouped  = column_traits_t<T>::grouped;
+	static constexpr bool has_buffered_columns = (detail::column_traits<Ts>::buffered || ...);
+	static_assert(BlockSize > 0, "BlockSize must be greater than zero");
+	static_assert(((detail::count_of<detail::column_value_t<Ts>, detail::column_value_t<Ts>...> == 1) && ...), "Column types must be unique");
+	template <typename> friend struct shared_allocator;
+	template <typename> friend struct shared_view;
+	static constexpr size_t rows_per_block    = BlockSize;
+	static constexpr bool has_trivial_columns = (std::is_trivially_copyable_v<detail::column_value_t<Ts>> && ...);
+	// Identifies the layout of a block, so that a shared_view can tell whether
+	// a region was formatted for the same table type.
+	[[nodiscard]] static constexpr
+	auto layout_hash() -> uint64_t {
+		return detail::hash_layout({uint64_t{BlockSize}, uint64_t{sizeof(block_t)}, uint64_t{alignof(block_t)}, uint64_t{sizeof(detail::column_value_t<Ts>)}..., uint64_t{alignof(detail::column_value_t<Ts>)}...});
+	}
+	// The same, for files written by save(), which only hold the columns and
+	// occupancy bitmaps.
+	[[nodiscard]] static constexpr
+	auto file_layout_hash() -> uint64_t {
+		return detail::hash_layout({uint64_t{BlockSize}, uint64_t{sizeof(detail::column_value_t<Ts>)}...});
+	}
+	[[nodiscard]] static
+	auto get(block_t* block, sub_index idx) -> row_t {
+		return row_t{get<detail::column_value_t<Ts>>(block, idx)...};
+	}
+	[[nodiscard]] static
+	auto get(const block_t& block, sub_index idx) -> const_row_t {
+		return const_row_t{get<detail::column_value_t<Ts>>(block, idx)...};
+	}
+	static auto reset(block_t* block, sub_index idx) -> void                                             { (reset<detail::column_value_t<Ts>>(block, idx), ...); }
+	auto clear_block(block_t* block) -> void                                                             { (clear_column<detail::column_value_t<Ts>>(block), ...); mark_all_dirty(block); }
+	static auto mark_all_dirty(block_t* block) -> void                                                   { (mark_all_dirty<detail::column_value_t<Ts>>(block), ...); }
+	template <typename T> [[nodiscard]] static auto column(block_t* block) -> column_t<T>&               { static_assert(!is_grouped<T>, "Grouped columns aren't stored contiguously"); return std::get<column_index<T>>(block->data).values; }
+	template <typename T> [[nodiscard]] static auto column(const block_t& block) -> const column_t<T>&   { static_assert(!is_grouped<T>, "Grouped columns aren't stored contiguously"); return std::get<column_index<T>>(block.data).values; }
+	template <typename T> [[nodiscard]] static auto group_rows(block_t* block) -> auto&                  { return std::get<column_index<typename column_traits_t<T>::first_type>>(block->data).rows; }
+	template <typename T> [[nodiscard]] static auto group_rows(const block_t& block) -> const auto&      { return std::get<column_index<typename column_traits_t<T>::first_type>>(block.data).rows; }
+	// Something which can be indexed by sub index to get T's values in a block,
+	// whether or not T is grouped: a plain pointer, or a detail::member_ptr.
+	template <typename T> [[nodiscard]] static auto column_data(block_t* block) -> decltype(auto) {
+		if constexpr (is_grouped<T>) { return detail::member_ptr<typename column_traits_t<T>::group_row_t, column_traits_t<T>::member>{group_rows<T>(block).data()}; }
+		else                         { return column<T>(block).data(); }
+	}
+	template <typename T> [[nodiscard]] static auto column_data(const block_t& block) -> decltype(auto) {
+		if constexpr (is_grouped<T>) { return detail::member_ptr<const typename column_traits_t<T>::group_row_t, column_traits_t<T>::member>{group_rows<T>(block).data()}; }
+		else                         { return column<T>(block).data(); }
+	}
+	template <typename T> [[nodiscard]] static auto get(block_t* block, sub_index idx) -> T&             { return column_data<T>(block)[idx.value]; }
+	template <typename T> [[nodiscard]] static auto get(const block_t& block, sub_index idx) -> const T& { return column_data<T>(block)[idx.value]; }
+	template <typename T> auto set(block_t* block, sub_index idx, T&& value) -> T& {
+		auto& result = get<std::decay_t<T>>(block, idx) = std::forward<T>(value);
+		mark_dirty<std::decay_t<T>>(block, idx);
+		return result;
+	}
+	template <typename T> static auto reset(block_t* block, sub_index idx) -> void                       { detail::reset_values(&get<T>(block, idx), 1); mark_dirty<T>(block, idx); }
+	// Resets count consecutive values of a column, without marking them.
+	template <typename T> static auto reset_values(block_t* block, sub_index first, size_t count) -> void {
+		if constexpr (is_grouped<T>) {
+			for (size_t i = 0; i < count; ++i) {
+				get<T>(block, {first.value + i}) = T{};
+			}
+		}
+		else {
+			detail::reset_values(&get<T>(block, first), count);
+		}
+	}
+	template <typename T> static auto mark_dirty(block_t* block, sub_index idx) -> void {
+		if constexpr (is_tracked<T>) {
+			const auto bit = detail::word_t{1} << (idx.value % detail::word_bits);
+			// Release pairs with the acquire in consume_dirty() so that the consumer
+			// sees the value which was written before the row was marked.
+			std::get<column_index<T>>(block->data).dirty[idx.value / detail::word_bits].fetch_or(bit, std::memory_order_release);
+		}
+	}
+	template <typename T> static auto copy_to_snapshot(block_t* block, uint8_t buffer) -> void {
+		if constexpr (is_buffered<T>) {
+			auto& storage = std::get<column_index<T>>(block->data);
+			std::copy(storage.values.begin(), storage.values.end(), storage.snapshots[buffer].begin());
+		}
+	}
+	template <typename T> static auto mark_all_dirty(block_t* block) -> void {
+		if constexpr (is_tracked<T>) {
+			auto& dirty = std::get<column_index<T>>(block->data).dirty;
+			for (size_t w = 0; w < word_count; ++w) {
+				dirty[w].store(valid_bits(w), std::memory_order_release);
+			}
+		}
+	}
+	template <typename T> auto clear_column(block_t* block) -> void {
+		if constexpr (is_grouped<T>) {
+			// The whole group is cleared along with its first column.
+			if constexpr (column_traits_t<T>::member == 0) {
+				auto& rows = group_rows<T>(block);
+				if constexpr (column_traits_t<T>::zero_group) {
+					allocator_->zero(static_cast<void*>(rows.data()), sizeof(rows));
+				}
+				else {
+					std::fill(rows.begin(), rows.end(), typename column_traits_t<T>::group_row_t{});
+				}
+			}
+		}
+		else {
+			auto& values = column<T>(block);
+			if constexpr (is_zero_initializable_v<T>) {
+				allocator_->zero(static_cast<void*>(values.data()), sizeof(values));
+			}
+			else {
+				std::fill(values.begin(), values.end(), T{});
+			}
+		}
+	}
+public:
+	basic_table() = default;
+	explicit basic_table(ent::allocator& allocator) : allocator_{&allocator} {}
+	basic_table(const basic_table&) = delete;
+	basic_table& operator=(const basic_table&) = delete;
+	basic_table(basic_table&& other) noexcept
+		: allocator_{other.allocator_}
+		, spare_blocks_{std::move(other.spare_blocks_)}
+		, spare_count_{other.spare_count_.load()}
+		, low_water_mark_{other.low_water_mark_.load()}
+		, directory_{other.directory_.load()}
+		, directory_capacity_{other.directory_capacity_}
+		, directories_{std::move(other.directories_)}
+		, block_count_{other.block_count_.load()}
+		, active_count_{other.active_count_.load()}
+		, search_hint_{other.search_hint_.load()}
+		, epoch_{other.epoch_.load()}
+		, buffer_state_{other.buffer_state_.load()}
+		, back_buffer_{other.back_buffer_}
+		, front_buffer_{other.front_buffer_}
+		, indexes_{std::move(other.indexes_)}
+		, ordered_indexes_{std::move(other.ordered_indexes_)}
+		, deferred_{std::move(other.deferred_)}
+	{
+		other.directory_ = nullptr;
+		other.directory_capacity_ = 0;
+		other.block_count_  = 0;
+		other.active_count_ = 0;
+		other.search_hint_  = 0;
+	}
+	basic_table& operator=(basic_table&& other) noexcept {
+		if (this != &other) {
+			erase_blocks();
+			allocator_          = other.allocator_;
+			spare_blocks_       = std::move(other.spare_blocks_);
+			spare_count_.store(other.spare_count_.load());
+			low_water_mark_.store(other.low_water_mark_.load());
+			directory_.store(other.directory_.load());
+			directory_capacity_ = other.directory_capacity_;
+			directories_        = std::move(other.directories_);
+			block_count_.store(other.block_count_.load());
+			active_count_.store(other.active_count_.load());
+			search_hint_.store(other.search_hint_.load());
+			epoch_.store(other.epoch_.load());
+			buffer_state_.store(other.buffer_state_.load());
+			back_buffer_        = other.back_buffer_;
+			front_buffer_       = other.front_buffer_;
+			indexes_            = std::move(other.indexes_);
+			ordered_indexes_    = std::move(other.ordered_indexes_);
+			deferred_           = std::move(other.deferred_);
+			other.directory_    = nullptr;
+			other.directory_capacity_ = 0;
+			other.block_count_  = 0;
+			other.active_count_ = 0;
+			other.search_hint_  = 0;
+		}
+		return *this;
+	}
+	~basic_table() { erase_blocks(); }
+	[[nodiscard]]
+	auto acquire(ent::lock_t) -> size_t {
+		const auto lock = lock_mutex();
+		for (;;) {
+			if (const auto index = claim_free_index()) {
+				return *index;
+			}
+			add_block();
+		}
+	}
+	// Acquires count rows, writing their indices to out, and returns the
+	// iterator past the last one written. The lock is only taken once, rows
+	// are claimed up to 64 at a time, and if the table needs to grow then every
+	// block it needs is added in one go.
+	template <typename OutIt>
+	auto acquire_n(ent::lock_t, size_t count, OutIt out) -> OutIt {
+		const auto lock = lock_mutex();
+		return acquire_rows(count, out);
+	}
+	// Deferred acquire and release, for realtime threads which need to create
+	// and destroy rows but can't wait for the lock. reserve_deferred() sets
+	// up a pool of pool_size rows which are acquired ahead of time, and a
+	// queue for up to release_capacity releases. defer_acquire() takes a row
+	// from the pool and defer_release() queues a row to be released, both
+	// without the lock and without allocating. flush() then releases the
+	// queued rows (updating the indexes of indexed columns) and acquires rows
+	// to top the pool up again, growing the table if it has to, so calling it
+	// regularly from a non-realtime thread keeps the pool full.
+	// NOTE: Rows in the pool count as acquired, so visit_active() and
+	// get_active_row_count() include them (with reset values), and a row
+	// whose release is queued stays acquired (and its handles alive) until the
+	// next flush. Rows taken from the pool are like rows from try_acquire():
+	// they're only added to the indexes of indexed columns when those are
+	// written with set(ent::lock, ...). reserve_deferred() must not be called
+	// concurrently with defer_acquire() or defer_release().
+	auto reserve_deferred(ent::lock_t, size_t pool_size, size_t release_capacity) -> void {
+		const auto lock = lock_mutex();
+		if (deferred_) {
+			apply_deferred_releases();
+			return_pool();
+		}
+		deferred_ = std::make_unique<deferred_t>(pool_size, release_capacity);
+		fill_pool();
+	}
+	// Realtime-safe. Returns std::nullopt if the pool is empty (or
+	// reserve_deferred() was never called.)
+	[[nodiscard]]
+	auto defer_acquire() -> std::optional<size_t> {
+		if (!deferred_) {
+			return std::nullopt;
+		}
+		while (const auto row = deferred_->pool.try_pop()) {
+			deferred_->pooled.fetch_sub(1, std::memory_order_relaxed);
+			// The row might have been released by clear() since it was pooled.
+			if (is_alive(*row)) {
+				return row->index();
+			}
+		}
+		return std::nullopt;
+	}
+	// Realtime-safe. Returns false if the queue is full, in which case nothing
+	// happens. What gets queued is a handle to the row, so if the row is
+	// released by something else (e.g. clear() or compact()) before the next
+	// flush, the queued release is skipped rather than hitting whichever row
+	// has that index by then.
+	[[nodiscard]]
+	auto defer_release(handle h) -> bool {
+		return deferred_ && deferred_->releases.try_push(h);
+	}
+	[[nodiscard]]
+	auto defer_release(size_t elem_index) -> bool {
+		return deferred_ && defer_release(get_handle(elem_index));
+	}
+	// Applies the queued releases and refills the pool. Returns the number of
+	// rows released.
+	auto flush(ent::lock_t) -> size_t {
+		const auto lock = lock_mutex();
+		if (!deferred_) {
+			return 0;
+		}
+		const auto released = apply_deferred_releases();
+		fill_pool();
+		return released;
+	}
+private:
+	struct deferred_t {
+		deferred_t(size_t pool_size, size_t release_capacity)
+			: pool{std::max(pool_size, size_t{1})}
+			, releases{std::max(release_capacity, size_t{1})}
+			, pool_size{pool_size}
+		{
+			scratch.reserve(pool_size);
+		}
+		detail::mpmc_ring<handle> pool;
+		detail::mpmc_ring<handle> releases;
+		size_t                    pool_size;
+		std::atomic<size_t>       pooled = 0;
+		std::vector<size_t>       scratch;
+	};
+	auto apply_deferred_releases() -> size_t {
+		size_t released = 0;
+		while (const auto row = deferred_->releases.try_pop()) {
+			if (release_locked(*row)) {
+				released++;
+			}
+		}
+		return released;
+	}
+	auto fill_pool() -> void {
+		const auto pooled = deferred_->pooled.load(std::memory_order_relaxed);
+		if (pooled >= deferred_->pool_size) {
+			return;
+		}
+		auto& scratch = deferred_->scratch;
+		scratch.clear();
+		acquire_rows(deferred_->pool_size - pooled, std::back_inserter(scratch));
+		for (const auto elem_index : scratch) {
+			// Only the lock holder pushes, and never more than the pool has room for.
+			(void)deferred_->pool.try_push(get_handle(elem_index));
+		}
+		deferred_->pooled.fetch_add(scratch.size(), std::memory_order_relaxed);
+	}
+	// Forgets the pooled rows, which clear() and clear_lazy() have already
+	// released.
+	auto drop_pool() -> void {
+		if (!deferred_) {
+			return;
+		}
+		while (deferred_->pool.try_pop()) {
+			deferred_->pooled.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+	// Gives the rows which are still in the pool back to the table.
+	auto return_pool() -> void {
+		while (const auto row = deferred_->pool.try_pop()) {
+			if (is_alive(*row)) {
+				release(row->index());
+			}
+		}
+		deferred_->pooled.store(0, std::memory_order_relaxed);
+	}
+	template <typename OutIt>
+	auto acquire_rows(size_t count, OutIt out) -> OutIt {
+		const auto free = get_capacity() - active_count_.load(std::memory_order_relaxed);
+		if (count > free) {
+			const auto blocks = (count - free + BlockSize - 1) / BlockSize;
+			reserve_directory(block_count_.load(std::memory_order_relaxed) + blocks);
+			for (size_t i = 0; i < blocks; ++i) {
+				add_block();
+			}
+		}
+		while (count > 0) {
+			const auto claimed = claim_free_indices(count, out, true);
+			if (claimed == 0) {
+				// Rows were taken by a concurrent try_acquire().
+				add_block();
+			}
+			count -= claimed;
+		}
+		return out;
+	}
+public:
+	// Releases every index in the range with the lock only taken once. Each
+	// column is reset in a separate pass, and runs of consecutive indices are
+	// reset with a single fill (or memset for trivial types), so releasing
+	// sorted indices is much faster than releasing them one by one.
+	template <typename Range>
+	auto release_n(ent::lock_t, const Range& indices) -> void {
+		const auto lock = lock_mutex();
+		for (const auto elem_index : indices) {
+			(void)make_lookup(elem_index);
+		}
+		for (const auto elem_index : indices) {
+			unindex_row(elem_index);
+		}
+		(reset_runs<detail::column_value_t<Ts>>(indices), ...);
+		for (const auto elem_index : indices) {
+			const auto lookup = make_lookup(elem_index);
+			free_row(&get_block(lookup.block), lookup);
+		}
+	}
+	// Realtime-safe version of acquire(). Claims a free row without taking the
+	// lock, but will never allocate a new block. Returns std::nullopt if every
+	// row is in use, in which case you can fall back to acquire(ent::lock).
+	// If every row is in use but a block was prepared ahead of time (see
+	// reserve_blocks() and maintain()) then this will try to take the lock
+	// without waiting and link the prepared block into the table, which doesn't
+	// allocate anything.
+	[[nodiscard]]
+	auto try_acquire() -> std::optional<size_t> {
+		if (const auto index = claim_free_index()) {
+			return index;
+		}
+		if (spare_count_.load(std::memory_order_relaxed) == 0) {
+			stats_.add_failed_try_acquire();
+			return std::nullopt;
+		}
+		const auto lock = std::unique_lock{mutex_, std::try_to_lock};
+		if (!lock.owns_lock()) {
+			stats_.add_failed_try_acquire();
+			return std::nullopt;
+		}
+		for (;;) {
+			if (const auto index = claim_free_index()) {
+				return index;
+			}
+			if (spare_blocks_.empty()) {
+				stats_.add_failed_try_acquire();
+				return std::nullopt;
+			}
+			add_block();
+		}
+	}
+	auto release(ent::lock_t, size_t elem_index) -> void {
+		const auto lock = lock_mutex();
+		unindex_row(elem_index);
+		release(elem_index);
+	}
+	auto release_no_reset(ent::lock_t, size_t elem_index) -> void {
+		const auto lock = lock_mutex();
+		unindex_row(elem_index);
+		release_no_reset(elem_index);
+	}
+	// Realtime-safe version of release(). This can't update the indexes of
+	// indexed columns, but find_by() never returns a free row so the row just
+	// stays in them until they are next rebuilt.
+	auto release(size_t elem_index) -> void {
+		const auto lookup = make_lookup(elem_index);
+		auto& block       = get_block(lookup.block);
+		if (claim_release(&block, lookup.sub, generation(block, lookup.sub))) {
+			reset(&block, lookup.sub);
+			free_claimed_row(&block, lookup);
+		}
+	}
+	// Realtime-safe version of release_no_reset().
+	auto release_no_reset(size_t elem_index) -> void {
+		const auto lookup = make_lookup(elem_index);
+		free_row(&get_block(lookup.block), lookup);
+	}
+	// Handle versions of acquire() and release(). See ent::handle.
+	[[nodiscard]]
+	auto acquire_handle(ent::lock_t) -> handle {
+		return get_handle(acquire(ent::lock));
+	}
+	[[nodiscard]]
+	auto try_acquire_handle() -> std::optional<handle> {
+		if (const auto index = try_acquire()) {
+			return get_handle(*index);
+		}
+		return std::nullopt;
+	}
+	// These do nothing and return false if the handle is not alive.
+	// If several threads release the same handle at once, exactly one of them
+	// releases the row and gets true back.
+	auto release(ent::lock_t, handle h) -> bool {
+		const auto lock = lock_mutex();
+		return release_locked(h);
+	}
+	auto release(handle h) -> bool {
+		if (h.index() >= get_capacity()) {
+			return false;
+		}
+		const auto lookup = make_lookup(h.index());
+		auto& block       = get_block(lookup.block);
+		if (!claim_release(&block, lookup.sub, h.generation())) {
+			return false;
+		}
+		reset(&block, lookup.sub);
+		free_claimed_row(&block, lookup);
+		return true;
+	}
+	// A cache of rows for one thread which acquires and releases rows at a
+	// high rate. It claims free rows from the table in batches of batch_size
+	// and hands them out one at a time, and rows released into it are reset and
+	// kept for reuse, so most calls touch neither the lock nor the table's
+	// shared atomics. When it holds twice batch_size rows, the oldest batch is
+	// given back to the table. Give every thread its own cache (it isn't
+	// thread-safe), for example as a local in the thread's function, or as a
+	// thread_local if the table outlives the thread; either way the rows it
+	// holds go back to the table when it is destroyed or flush() is called.
+	// NOTE: Rows held by a cache are still acquired as far as the table is
+	// concerned, so visit_active() and get_active_row_count() include them
+	// (with reset values.) Handles to a row stop being alive when it is
+	// released into a cache. The same rules apply as for try_acquire() and the
+	// lock-free release(): don't use a cache concurrently with clear_lazy() or
+	// compact(), and the indexes of indexed columns aren't updated. Rows which
+	// are released by anything else while a cache holds them (e.g. by clear())
+	// are dropped from the cache. compact() would move the rows a cache holds
+	// and leave them acquired, so every cache which has been used since it was
+	// last flushed has to be flushed (or destroyed) first; compact() throws
+	// std::logic_error otherwise.
+	struct local_cache {
+		explicit local_cache(basic_table& table, size_t batch_size = 32)
+			: table_{&table}
+			, batch_size_{std::max(batch_size, size_t{1})}
+		{
+			rows_.reserve(batch_size_ * 2);
+			scratch_.resize(batch_size_);
+		}
+		local_cache(const local_cache&) = delete;
+		local_cache& operator=(const local_cache&) = delete;
+		~local_cache() { flush(); }
+		// Takes a row from the cache, refilling it from the table without the
+		// lock if it's empty (which never allocates a block.) Realtime-safe.
+		// Returns std::nullopt if the table has no free rows.
+		[[nodiscard]]
+		auto try_acquire() -> std::optional<size_t> {
+			if (const auto index = pop()) {
+				return index;
+			}
+			auto out = scratch_.data();
+			push_claimed(table_->claim_free_indices(batch_size_, out, false));
+			return pop();
+		}
+		// Like try_acquire(), but if the table is full this takes the lock and
+		// grows the table.
+		[[nodiscard]]
+		auto acquire(ent::lock_t) -> size_t {
+			if (const auto index = try_acquire()) {
+				return *index;
+			}
+			table_->acquire_n(ent::lock, batch_size_, scratch_.data());
+			push_claimed(batch_size_);
+			return *pop();
+		}
+		// Resets the row and keeps it in the cache. Realtime-safe. Like the
+		// table's release(), this does nothing if the row isn't acquired.
+		auto release(size_t elem_index) -> void {
+			const auto lookup = table_->make_lookup(elem_index);
+			auto& block       = table_->get_block(lookup.block);
+			const auto bit    = detail::word_t{1} << (lookup.sub.value % detail::word_bits);
+			if (!table_->is_current(block) || !(block.occupied[lookup.sub.value / detail::word_bits].load(std::memory_order_relaxed) & bit)) {
+				return;
+			}
+			reset(&block, lookup.sub);
+			// Rows stay claimed while they are cached, so the generation stays odd.
+			const auto generation = block.generations[lookup.sub.value].fetch_add(2, std::memory_order_relaxed) + 2;
+			if (rows_.size() == rows_.capacity()) {
+				give_back(batch_size_);
+			}
+			hold();
+			rows_.push_back(handle::make(elem_index, generation));
+		}
+		// Gives every cached row back to the table. Realtime-safe.
+		auto flush() -> void {
+			give_back(rows_.size());
+			if (holding_) {
+				holding_ = false;
+				table_->holding_caches_.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+		[[nodiscard]]
+		auto size() const -> size_t { return rows_.size(); }
+	private:
+		[[nodiscard]]
+		auto pop() -> std::optional<size_t> {
+			while (!rows_.empty()) {
+				const auto row = rows_.back();
+				rows_.pop_back();
+				if (table_->is_alive(row)) {
+					return row.index();
+				}
+			}
+			return std::nullopt;
+		}
+		// Counts this cache in the table's holding_caches_, which compact()
+		// checks, until the next flush().
+		auto hold() -> void {
+			if (!holding_) {
+				holding_ = true;
+				table_->holding_caches_.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		auto push_claimed(size_t count) -> void {
+			if (count > 0) {
+				hold();
+			}
+			for (size_t i = 0; i < count; ++i) {
+				rows_.push_back(table_->get_handle(scratch_[i]));
+			}
+		}
+		// Releases the oldest count rows back to the table.
+		auto give_back(size_t count) -> void {
+			for (size_t i = 0; i < count; ++i) {
+				if (table_->is_alive(rows_[i])) {
+					const auto lookup = table_->make_lookup(rows_[i].index());
+					table_->free_row(&table_->get_block(lookup.block), lookup);
+				}
+			}
+			rows_.erase(rows_.begin(), rows_.begin() + static_cast<std::ptrdiff_t>(count));
+		}
+		basic_table*        table_;
+		size_t              batch_size_;
+		std::vector<handle> rows_;
+		std::vector<size_t> scratch_;
+		bool                holding_ = false;
+	};
+	// Makes a handle for the row at this index, using the row's current
+	// generation. This is only useful if the row is currently acquired.
+	[[nodiscard]]
+	auto get_handle(size_t elem_index) const -> handle {
+		const auto lookup = make_lookup(elem_index);
+		return handle::make(elem_index, generation(get_block(lookup.block), lookup.sub));
+	}
+	// True if the handle's row hasn't been released since the handle was made.
+	// Of course the row could be released by another thread right after this
+	// returns, so you still need to coordinate with whoever releases rows.
+	[[nodiscard]]
+	auto is_alive(handle h) const -> bool {
+		if (h.index() >= get_capacity()) {
+			return false;
+		}
+		const auto lookup = make_lookup(h.index());
+		const auto& block = get_block(lookup.block);
+		return generation(block, lookup.sub) == h.generation() && is_current(block);
+	}
+	// Returns nullptr if the handle is not alive.
+	template <typename T> [[nodiscard]]
+	auto try_get(handle h) -> T* {
+		return is_alive(h) ? &get<T>(h.index()) : nullptr;
+	}
+	template <typename T> [[nodiscard]]
+	auto try_get(handle h) const -> const T* {
+		return is_alive(h) ? &get<T>(h.index()) : nullptr;
+	}
+	// Makes sure that at least block_count blocks are allocated and zeroed ahead
+	// of time, without adding them to the table yet. They are used up in order
+	// when the table grows, and the block directory is also grown ahead of time
+	// so that adding one of these blocks costs one pointer pop and no
+	// allocation.
+	auto reserve_blocks(ent::lock_t, size_t block_count) -> void {
+		const auto lock = lock_mutex();
+		reserve_spare_blocks(block_count);
+	}
+	// Sets the number of free rows below which maintain() will prepare another
+	// block ahead of time. Zero (the default) disables it.
+	auto set_low_water_mark(ent::lock_t, size_t row_count) -> void {
+		const auto lock = lock_mutex();
+		low_water_mark_.store(row_count, std::memory_order_relaxed);
+	}
+	// Returns true if the number of free rows (including the rows of any blocks
+	// which are ready to be linked in) has dropped below the low-water mark.
+	// This is realtime-safe so it can be polled from the audio thread to decide
+	// whether to wake up whichever thread calls maintain().
+	[[nodiscard]]
+	auto needs_maintenance() const -> bool {
+		return get_prepared_row_count() < low_water_mark_.load(std::memory_order_relaxed);
+	}
+	// Allocates and zeroes as many blocks as it takes to bring the number of free
+	// rows back up to the low-water mark, without adding them to the table yet.
+	// When the table next runs out of rows, acquire() and try_acquire() will
+	// link one of these in rather than allocating. Call this periodically (or
+	// when needs_maintenance() returns true) from a non-realtime thread.
+	auto maintain(ent::lock_t) -> void {
+		const auto lock = lock_mutex();
+		// Also get any blocks left stale by clear_lazy() out of the way, so that
+		// realtime threads don't have to.
+		with_each_block([this](block_t* block) { refresh_block(block, true); });
+		const auto low_water_mark = low_water_mark_.load(std::memory_order_relaxed);
+		const auto prepared_rows  = get_prepared_row_count();
+		if (prepared_rows >= low_water_mark) {
+			return;
+		}
+		const auto missing_blocks = (low_water_mark - prepared_rows + BlockSize - 1) / BlockSize;
+		reserve_spare_blocks(spare_blocks_.size() + missing_blocks);
+	}
+	// Frees every block which was prepared ahead of time or parked by compact().
+	auto free_reserved_blocks(ent::lock_t) -> void {
+		const auto lock = lock_mutex();
+		for (const auto block : spare_blocks_) {
+			destroy_block(block);
+		}
+		spare_blocks_.clear();
+		spare_count_.store(0, std::memory_order_relaxed);
+	}
+	[[nodiscard]]
+	auto get_reserved_block_count(ent::lock_t) const -> size_t {
+		const auto lock = lock_mutex();
+		return spare_blocks_.size();
+	}
+	// NOTE: Must not be called concurrently with try_acquire() or the lock-free
+	// release() overloads.
+	auto clear(ent::lock_t) -> void {
+		const auto lock = lock_mutex();
+		stats_.add_clear();
+		clear_all();
+	}
+	// Like clear(), but only costs O(blocks). Every row is released immediately
+	// (handles stop being alive, visit_active() skips them and they can be
+	// acquired again) but the columns aren't reset until a block is next
+	// needed by acquire(), try_acquire() or acquire_n(), or maintain() is
+	// called. Until then, the free rows of a stale block may still contain
+	// their old values if you read them through get() or visit(). The indexes
+	// of indexed columns aren't touched either; find_by() ignores released
+	// rows and the entries are dropped when the indexes are next rebuilt.
+	// NOTE: Must not be called concurrently with try_acquire() or the lock-free
+	// release() overloads.
+	auto clear_lazy(ent::lock_t) -> void {
+		const auto lock = lock_mutex();
+		stats_.add_clear();
+		const auto epoch = epoch_.fetch_add(1, std::memory_order_release) + 1;
+		allocator_->publish_state(block_count_.load(std::memory_order_relaxed), epoch);
+		active_count_.store(0, std::memory_order_release);
+		search_hint_.store(0, std::memory_order_relaxed);
+		drop_pool();
+	}
+	// Moves rows from the end of the table into free rows at the start until
+	// every acquired row is in the lowest blocks, then removes the blocks which
+	// are left empty at the end. Those are parked and will be reused when the
+	// table grows again (call free_reserved_blocks() to really free them.)
+	// remap(old_index, new_index) is called for every row which was moved.
+	// Handles to a moved row stop being alive; make a new one with
+	// get_handle(new_index). Returns the number of rows moved. The deferred
+	// releases are applied and the deferred acquire pool is given back first,
+	// and the pool is filled again afterwards (see reserve_deferred().)
+	// NOTE: This invalidates the indices of the rows which are moved, so
+	// nothing else should be accessing them while it runs. It must also not be
+	// called concurrently with try_acquire() or the lock-free release()
+	// overloads. Throws std::logic_error if a local_cache still holds rows.
+	template <typename RemapFn>
+	auto compact(ent::lock_t, RemapFn&& remap) -> size_t {
+		const auto lock = lock_mutex();
+		if (holding_caches_.load(std::memory_order_relaxed) > 0) {
+			throw std::logic_error("Every local_cache must be flushed before compact()");
+		}
+		if (deferred_) {
+			apply_deferred_releases();
+			return_pool();
+		}
+		with_each_block([this](block_t* block) { refresh_block(block, true); });
+		const auto block_count = block_count_.load(std::memory_order_relaxed);
+		const auto capacity    = block_count * BlockSize;
+		size_t moved = 0;
+		size_t low   = 0;
+		size_t high  = capacity;
+		for (;;) {
+			low  = find_free_row(low, capacity);
+			high = find_occupied_row_before(high);
+			if (low >= high || high == capacity) {
+				break;
+			}
+			move_row(high, low);
+			remap(high, low);
+			moved++;
+			low++;
+		}
+		const auto keep = (active_count_.load(std::memory_order_relaxed) + BlockSize - 1) / BlockSize;
+		if (keep < block_count) {
+			const auto directory = directory_.load(std::memory_order_relaxed);
+			spare_blocks_.reserve(spare_blocks_.size() + (block_count - keep));
+			block_count_.store(keep, std::memory_order_release);
+			allocator_->publish_state(keep, epoch_.load(std::memory_order_relaxed));
+			// Parked blocks are handed out again by add_block() as they are, so
+			// they have to be clean (rows released with release_no_reset() may
+			// have left values behind.)
+			for (size_t b = block_count; b > keep; --b) {
+				clear_block(directory[b - 1]);
+				spare_blocks_.push_back(directory[b - 1]);
+			}
+			spare_count_.store(spare_blocks_.size(), std::memory_order_relaxed);
+		}
+		search_hint_.store(0, std::memory_order_relaxed);
+		if (deferred_) {
+			fill_pool();
+		}
+		return moved;
+	}
+	// Calls fn(block_index, occupancy, columns...) for every block, where each
+	// argument after the index is an ent::span<const std::byte> over raw block
+	// memory: first a copy of the block's occupancy bitmap (one bit per row in
+	// 64-bit words, in native byte order), then each requested column array
+	// (BlockSize * sizeof(C) bytes, including the free rows.) Nothing else is
+	// copied, so the spans can be handed straight to writev() or memcpy'd into
+	// shared memory. They are only valid until fn returns.
+	//   table.export_blocks<A, B>(ent::lock, [](size_t block, auto occupancy, auto a, auto b) { ... });
+	// NOTE: The lock doesn't stop try_acquire(), the lock-free release()
+	// overloads or writes through get(), so don't use those meanwhile if you
+	// need a consistent snapshot.
+	template <typename... Cs, typename Fn>
+	auto export_blocks(ent::lock_t, Fn&& fn) const -> void {
+		static_assert((std::is_trivially_copyable_v<Cs> && ...), "Only trivially copyable columns can be exported");
+		static_assert((!is_grouped<Cs> && ...), "Grouped columns can't be exported");
+		const auto lock  = lock_mutex();
+		const auto count = block_count_.load(std::memory_order_acquire);
+		for (size_t b = 0; b < count; ++b) {
+			const auto& block = get_block({b});
+			auto occupancy    = std::array<detail::word_t, word_count>{};
+			if (is_current(block)) {
+				for (size_t w = 0; w < word_count; ++w) {
+					occupancy[w] = block.occupied[w].load(std::memory_order_acquire);
+				}
+			}
+			fn(b, as_bytes(std::as_const(occupancy)), as_bytes(column<Cs>(block))...);
+		}
+	}
+	// The other half of export_blocks(). Clears the table and makes sure it
+	// has at least block_count blocks, then calls fn(block_index, occupancy,
+	// columns...) for each of the first block_count blocks with writable
+	// ent::span<std::byte> views laid out exactly like the ones export_blocks()
+	// passes, for fn to fill in (with read(), memcpy() or whatever.) Columns
+	// which aren't requested are left reset. Afterwards the rows marked in the
+	// occupancy bitmaps are acquired, and the indexes of indexed and ordered
+	// columns are rebuilt. Handles made before the import are not alive.
+	// NOTE: Must not be called concurrently with anything else.
+	template <typename... Cs, typename Fn>
+	auto import_blocks(ent::lock_t, size_t block_count, Fn&& fn) -> void {
+		static_assert((std::is_trivially_copyable_v<Cs> && ...), "Only trivially copyable columns can be imported");
+		static_assert((!is_grouped<Cs> && ...), "Grouped columns can't be imported");
+		const auto lock = lock_mutex();
+		clear_all();
+		reserve_directory(block_count);
+		while (block_count_.load(std::memory_order_relaxed) < block_count) {
+			add_block();
+		}
+		size_t active = 0;
+		for (size_t b = 0; b < block_count; ++b) {
+			auto& block    = get_block({b});
+			auto occupancy = std::array<detail::word_t, word_count>{};
+			fn(b, as_bytes(occupancy), as_bytes(column<Cs>(&block))...);
+			for (size_t w = 0; w < word_count; ++w) {
+				const auto bits = occupancy[w] & valid_bits(w);
+				for (auto rest = bits; rest; rest &= rest - 1) {
+					// Generations are odd while a row is acquired.
+					block.generations[(w * detail::word_bits) + detail::ctz(rest)].fetch_add(1, std::memory_order_relaxed);
+				}
+				block.occupied[w].store(bits, std::memory_order_release);
+				active += detail::popcount(bits);
+			}
+			mark_all_dirty(&block);
+		}
+		active_count_.store(active, std::memory_order_release);
+		if constexpr (((detail::column_traits<Ts>::indexed || detail::column_traits<Ts>::ordered) || ...)) {
+			for (size_t i = 0; i < block_count * BlockSize; ++i) {
+				index_row(i);
+			}
+		}
+	}
+	// Writes the table to a file as a header followed by every block, laid out
+	// as export_blocks() passes them (the occupancy bitmap and then every
+	// column.) The format is versioned, but it keeps native byte order and the
+	// columns' own representation, so a file can only be loaded by a build
+	// which agrees on the block size and column types (load_mapped() checks.)
+	// Every column must be trivially copyable and not part of a group. Throws
+	// std::system_error if the file can't be written.
+	auto save(ent::lock_t, const char* path) const -> void {
+		auto file   = detail::file_writer{path};
+		auto header = detail::file_header{};
+		header.layout = file_layout_hash();
+		file.write(&header, sizeof(header));
+		export_blocks<detail::column_value_t<Ts>...>(ent::lock, [&file, &header](size_t, auto occupancy, auto... columns) {
+			for (size_t w = 0; w < word_count; ++w) {
+				header.row_count += detail::popcount(reinterpret_cast<const detail::word_t*>(occupancy.data())[w]);
+			}
+			file.write(occupancy.data(), occupancy.size());
+			(file.write(columns.data(), columns.size()), ...);
+			header.block_count++;
+		});
+		file.write_header(header);
+		file.close();
+	}
+	// Replaces the contents of the table with a file written by save(). The
+	// file is mapped into memory (where mmap is available) and copied in a
+	// block at a time, so this costs about as much as reading the file. Throws
+	// std::runtime_error if the file wasn't saved from the same kind of table,
+	// or std::system_error if it can't be read. Like import_blocks(), this
+	// must not be called concurrently with anything else.
+	auto load_mapped(ent::lock_t, const char* path) -> void {
+		constexpr auto block_bytes = (word_count * sizeof(detail::word_t)) + (sizeof(column_t<detail::column_value_t<Ts>>) + ...);
+		const auto file   = detail::mapped_file{path};
+		const auto bytes  = file.get_bytes();
+		const auto header = detail::read_file_header(bytes, file_layout_hash());
+		detail::check_file_size(bytes, header.block_count, block_bytes);
+		auto src = bytes.data() + sizeof(header);
+		import_blocks<detail::column_value_t<Ts>...>(ent::lock, static_cast<size_t>(header.block_count), [&src](size_t, auto... spans) {
+			((std::memcpy(spans.data(), src, spans.size()), src += spans.size()), ...);
+		});
+	}
+	[[nodiscard]]
+	auto get_capacity() const -> size_t {
+		return (block_count_ * BlockSize);
+	}
+	[[nodiscard]]
+	auto get_active_row_count(ent::lock_t) const -> size_t {
+		const auto lock = lock_mutex();
+		return active_count_.load(std::memory_order_acquire);
+	}
+	// Realtime-safe. Returns all zeros unless ENT_STATS is defined; see
+	// ent::table_stats.
+	[[nodiscard]]
+	auto get_stats() const -> table_stats {
+		return stats_.get();
+	}
+	template <typename T, typename PredFn> [[nodiscard]]
+	auto find(ent::lock_t, PredFn&& pred) -> std::optional<size_t> {
+		const auto lock = lock_mutex();
+		std::optional<size_t> result;
+		scan_blocks(*this, [&pred, &result](block_t& block, size_t base) {
+			const auto values = column_data<T>(&block);
+			for (size_t i = 0; i < BlockSize; ++i) {
+				if (pred(values[i])) {
+					result = base + i;
+					return true;
+				}
+			}
+			return false;
+		});
+		return result;
+	}
+	// Vectorized queries over the acquired rows of a column. The column is
+	// compared 64 rows at a time with SIMD instructions where possible (see
+	// detail::compare_word) and the result is masked with the occupancy bitmap,
+	// so free rows are never matched:
+	//   table.find<NoteId>(ent::lock, ent::cmp::eq, note);
+	//   table.count_if<float>(ent::lock, ent::cmp::gt, 0.5f);
+	// These are fastest for 32-bit float, integer and enum columns, and fall
+	// back to scalar loops for any other type which supports the comparison.
+	// Grouped columns aren't supported because they aren't contiguous.
+	template <typename T> [[nodiscard]]
+	auto find(ent::lock_t, ent::cmp op, const T& value) const -> std::optional<size_t> {
+		const auto lock = lock_mutex();
+		std::optional<size_t> result;
+		scan_compare(op, value, [&result](size_t base, detail::word_t bits) {
+			result = base + detail::ctz(bits);
+			return true;
+		});
+		return result;
+	}
+	template <typename T> [[nodiscard]]
+	auto count_if(ent::lock_t, ent::cmp op, const T& value) const -> size_t {
+		const auto lock = lock_mutex();
+		size_t result   = 0;
+		scan_compare(op, value, [&result](size_t, detail::word_t bits) {
+			result += detail::popcount(bits);
+			return false;
+		});
+		return result;
+	}
+	// Writes the indices of the matching rows to out in ascending order, and
+	// returns the iterator past the last one written.
+	template <typename T, typename OutIt>
+	auto find_all(ent::lock_t, ent::cmp op, const T& value, OutIt out) const -> OutIt {
+		const auto lock = lock_mutex();
+		scan_compare(op, value, [&out](size_t base, detail::word_t bits) {
+			while (bits) {
+				*out++ = base + detail::ctz(bits);
+				bits &= bits - 1;
+			}
+			return false;
+		});
+		return out;
+	}
+	// Reductions over the acquired rows of a column. get_min() and get_max()
+	// return std::nullopt if there are no acquired rows. Runs of 64 acquired
+	// rows are reduced with SIMD instructions where possible, so the order in
+	// which a float column is summed isn't specified.
+	template <typename T> [[nodiscard]]
+	auto get_sum(ent::lock_t) const -> T {
+		const auto lock = lock_mutex();
+		return *reduce<detail::reduction::sum, T>(T{});
+	}
+	template <typename T> [[nodiscard]]
+	auto get_min(ent::lock_t) const -> std::optional<T> {
+		const auto lock = lock_mutex();
+		return reduce<detail::reduction::min, T>(std::nullopt);
+	}
+	template <typename T> [[nodiscard]]
+	auto get_max(ent::lock_t) const -> std::optional<T> {
+		const auto lock = lock_mutex();
+		return reduce<detail::reduction::max, T>(std::nullopt);
+	}
+	template <typename Fn>
+	auto visit(ent::lock_t, Fn&& fn) -> void {
+		const auto lock     = lock_mutex();
+		const auto capacity = block_count_ * BlockSize;
+		for (size_t i = 0; i < capacity; ++i) {
+			fn(i);
+		}
+	}
+	// Visits every row, passing references to each of the requested columns:
+	//   table.visit<A, B, C>(ent::lock, [](size_t index, A& a, B& b, C& c) { ... });
+	// Each column array is only looked up once per block.
+	template <typename C, typename... Cs, typename Fn>
+	auto visit(ent::lock_t, Fn&& fn) -> void {
+		const auto lock = lock_mutex();
+		scan_blocks(*this, [&fn](block_t& block, size_t base) {
+			visit_block(base, fn, column_data<C>(&block), column_data<Cs>(&block)...);
+			return false;
+		});
+	}
+	template <typename C, typename... Cs, typename Fn>
+	auto visit(ent::lock_t, Fn&& fn) const -> void {
+		const auto lock = lock_mutex();
+		scan_blocks(*this, [&fn](const block_t& block, size_t base) {
+			visit_block(base, fn, column_data<C>(block), column_data<Cs>(block)...);
+			return false;
+		});
+	}
+	// Visits the table one block at a time. For each block the callback receives
+	// the element index of the block's first row, followed by a span over each
+	// requested column of that block:
+	//   table.visit_spans<A, B>(ent::lock, [](size_t base, ent::span<A> a, ent::span<B> b) { ... });
+	// Every span has exactly BlockSize elements, and element i of each span
+	// belongs to row (base + i). Grouped columns can't be visited this way.
+	template <typename... Cs, typename Fn>
+	auto visit_spans(ent::lock_t, Fn&& fn) -> void {
+		static_assert(sizeof...(Cs) > 0, "visit_spans requires at least one column");
+		static_assert((!is_grouped<Cs> && ...), "visit_spans can't be used with grouped columns");
+		const auto lock = lock_mutex();
+		scan_blocks(*this, [&fn](block_t& block, size_t base) {
+			fn(base, ent::span<Cs>{column<Cs>(&block).data(), BlockSize}...);
+			return false;
+		});
+	}
+	template <typename... Cs, typename Fn>
+	auto visit_spans(ent::lock_t, Fn&& fn) const -> void {
+		static_assert(sizeof...(Cs) > 0, "visit_spans requires at least one column");
+		static_assert((!is_grouped<Cs> && ...), "visit_spans can't be used with grouped columns");
+		const auto lock = lock_mutex();
+		scan_blocks(*this, [&fn](const block_t& block, size_t base) {
+			fn(base, ent::span<const Cs>{column<Cs>(block).data(), BlockSize}...);
+			return false;
+		});
+	}
+	// Makes an ent::column_view of these columns, which doesn't need the lock.
+	template <typename... Cs> [[nodiscard]]
+	auto view(ent::lock_t) -> column_view<BlockSize, Cs...> {
+		static_assert((!is_grouped<Cs> && ...), "Grouped columns can't be viewed");
+		const auto lock  = lock_mutex();
+		const auto count = block_count_.load(std::memory_order_relaxed);
+		auto result      = column_view<BlockSize, Cs...>{};
+		result.epoch_ = &epoch_;
+		result.blocks_.reserve(count);
+		result.segments_.reserve(count);
+		for (size_t b = 0; b < count; ++b) {
+			auto& block = get_block({b});
+			result.blocks_.push_back({{column<Cs>(&block).data()...}, block.occupied.data(), &block.epoch});
+			result.segments_.emplace_back(b * BlockSize, ent::span<Cs>{column<Cs>(&block).data(), BlockSize}...);
+		}
+		return result;
+	}
+	// Like visit(), but the rows are split into chunks which are handed to an
+	// executor (see ent::serial_executor and ent::thread_pool) to be visited in
+	// parallel. With no columns the callback is fn(index), otherwise it is
+	// fn(index, Cs&...) just like visit<Cs...>(). Each chunk is at most
+	// chunk_size rows and never crosses a block boundary.
+	// NOTE: The lock is held by the calling thread for the whole call, so no
+	// blocks can be added while the chunks are running. The block pointers are
+	// read on the calling thread before any task is started, and the executor
+	// guarantees that starting a task happens-after that, so the tasks never
+	// read the directory at all. Each row belongs to exactly one chunk, so fn
+	// can write to the row it was given without any synchronization, as long as
+	// it doesn't touch any other rows. Everything the tasks wrote is visible to
+	// the caller once parallel_visit returns.
+	template <typename... Cs, typename Executor, typename Fn>
+	auto parallel_visit(ent::lock_t, Executor&& executor, Fn&& fn, size_t chunk_size = BlockSize) -> void {
+		const auto lock        = lock_mutex();
+		chunk_size             = std::clamp<size_t>(chunk_size, 1, BlockSize);
+		const auto block_count = block_count_.load(std::memory_order_acquire);
+		const auto directory   = directory_.load(std::memory_order_acquire);
+		const auto chunks_per_block = (BlockSize + chunk_size - 1) / chunk_size;
+		executor(block_count * chunks_per_block, [&fn, directory, chunk_size, chunks_per_block](size_t task) {
+			const auto b     = task / chunks_per_block;
+			const auto begin = (task % chunks_per_block) * chunk_size;
+			const auto end   = std::min(begin + chunk_size, BlockSize);
+			[[maybe_unused]] const auto block = directory[b];
+			visit_range(b * BlockSize, begin, end, fn, column_data<Cs>(block)...);
+		});
+	}
+	// These are like find() and visit() except that they only visit rows which are
+	// currently acquired. Free rows are skipped 64 at a time using the occupancy
+	// bitmaps so their columns are never read.
+	template <typename T, typename PredFn> [[nodiscard]]
+	auto find_active(ent::lock_t, PredFn&& pred) -> std::optional<size_t> {
+		const auto lock = lock_mutex();
+		std::optional<size_t> result;
+		scan_active(*this, [&pred, &result](block_t& block, size_t i, sub_index sub) {
+			if (pred(get<T>(&block, sub))) {
+				result = i;
+				return true;
+			}
+			return false;
+		});
+		return result;
+	}
+	template <typename Fn>
+	auto visit_active(ent::lock_t, Fn&& fn) -> void {
+		const auto lock = lock_mutex();
+		scan_active(*this, [&fn](block_t&, size_t i, sub_index) { fn(i); return false; });
+	}
+	template <typename C, typename... Cs, typename Fn>
+	auto visit_active(ent::lock_t, Fn&& fn) -> void {
+		const auto lock = lock_mutex();
+		scan_active(*this, [&fn](block_t& block, size_t i, sub_index sub) { fn(i, get<C>(&block, sub), get<Cs>(&block, sub)...); return false; });
+	}
+	template <typename C, typename... Cs, typename Fn>
+	auto visit_active(ent::lock_t, Fn&& fn) const -> void {
+		const auto lock = lock_mutex();
+		scan_active(*this, [&fn](const block_t& block, size_t i, sub_index sub) { fn(i, get<C>(block, sub), get<Cs>(block, sub)...); return false; });
+	}
+	[[nodiscard]]
+	auto get(size_t idx) -> row_t {
+		auto lookup = make_lookup(idx);
+		auto& block = get_block(lookup.block);
+		return get(&block, lookup.sub);
+	}
+	[[nodiscard]]
+	auto get(size_t idx) const -> const_row_t {
+		auto lookup = make_lookup(idx);
+		auto& block = get_block(lookup.block);
+		return get(block, lookup.sub);
+	}
+	template <typename T>
+	auto set(size_t idx, T&& value) -> T& {
+		static_assert(!is_indexed<std::decay_t<T>> && !is_ordered<std::decay_t<T>>, "indexed and ordered columns must be set with set(ent::lock, ...)");
+		auto lookup = make_lookup(idx);
+		auto& block = get_block(lookup.block);
+		return set(&block, lookup.sub, std::forward<T>(value));
+	}
+	// Like set(), but also updates the index if the column is indexed or
+	// ordered. The row is only indexed if it is currently acquired.
+	template <typename T>
+	auto set(ent::lock_t, size_t idx, T&& value) -> T& {
+		using value_t   = std::decay_t<T>;
+		const auto lock = lock_mutex();
+		auto lookup     = make_lookup(idx);
+		auto& block     = get_block(lookup.block);
+		unindex_row<value_t>(idx);
+		auto& result = set(&block, lookup.sub, std::forward<T>(value));
+		index_row<value_t>(idx);
+		return result;
+	}
+	// Adds a row to the index of an indexed or ordered column using its current
+	// value. Call this after writing to the column through a reference from
+	// get<T>(). The entry for the row's old value (if the row had one) is left
+	// behind and dropped when the index is next rebuilt.
+	template <typename T>
+	auto reindex(ent::lock_t, size_t idx) -> void {
+		static_assert(is_indexed<T> || is_ordered<T>, "reindex requires a column declared with ent::indexed or ent::ordered");
+		const auto lock = lock_mutex();
+		(void)make_lookup(idx);
+		index_row<T>(idx);
+	}
+	// Returns an acquired row whose T column is equal to value, or std::nullopt
+	// if there isn't one. If more than one row holds the value then any of them
+	// may be returned. This is O(1) and realtime-safe: it doesn't take the lock
+	// and never waits for the writer. The only rows it reads are ones which
+	// held the value when they were indexed, so it is safe to call while other
+	// rows are being written, but like get() it must not race with writes to
+	// the rows which hold (or held) this value.
+	template <typename T> [[nodiscard]]
+	auto find_by(const T& value) const -> std::optional<size_t> {
+		static_assert(is_indexed<T>, "find_by requires a column declared with ent::indexed");
+		return std::get<column_index<T>>(indexes_).find(value, [this, &value](size_t row) {
+			const auto current = indexed_value<T>(row);
+			return current && *current == value;
+		});
+	}
+	// Visits the rows of an ordered column whose values are in [lo, hi), in
+	// ascending order of value (rows with equal values are visited in index
+	// order), passing references to any other requested columns:
+	//   table.visit_in_range<Start, Clip>(ent::lock, a, b, [](size_t index, const Start& start, Clip& clip) { ... });
+	// Only the rows in the range are looked at. The ordered column is passed
+	// by const reference; use set(ent::lock, ...) to change it.
+	template <typename T, typename... Cs, typename Fn>
+	auto visit_in_range(ent::lock_t, const T& lo, const T& hi, Fn&& fn) -> void {
+		static_assert(is_ordered<T>, "visit_in_range requires a column declared with ent::ordered");
+		const auto lock = lock_mutex();
+		std::get<column_index<T>>(ordered_indexes_).visit(lo, hi, [this, &fn](size_t row, const T& value) {
+			// Skip entries which have gone stale.
+			const auto current = indexed_value<T>(row);
+			if (!current || *current < value || value < *current) {
+				return;
+			}
+			fn(row, *current, get<Cs>(row)...);
+		});
+	}
+	// A consistent, read-only view of the buffered columns as they were at the
+	// last commit(). Columns which aren't buffered are read live, so
+	// get(idx) is only consistent for the buffered columns of the row.
+	struct committed_view {
+		template <typename T> [[nodiscard]]
+		auto get(size_t idx) const -> const T& {
+			const auto lookup = table_->make_lookup(idx);
+			const auto& block = table_->get_block(lookup.block);
+			if constexpr (is_buffered<T>) {
+				return std::get<column_index<T>>(block.data).snapshots[buffer_][lookup.sub.value];
+			}
+			else {
+				return basic_table::get<T>(block, lookup.sub);
+			}
+		}
+		[[nodiscard]]
+		auto get(size_t idx) const -> const_row_t {
+			return const_row_t{get<detail::column_value_t<Ts>>(idx)...};
+		}
+		template <typename T> [[nodiscard]]
+		auto get_span(size_t block_index) const -> ent::span<const T> {
+			static_assert(is_buffered<T>, "get_span requires a column declared with ent::buffered");
+			const auto& block = table_->get_block({block_index});
+			return {std::get<column_index<T>>(block.data).snapshots[buffer_].data(), BlockSize};
+		}
+	private:
+		committed_view(const basic_table* t, uint8_t buffer) : table_{t}, buffer_{buffer} {}
+		const basic_table* table_;
+		uint8_t            buffer_;
+		friend struct basic_table;
+	};
+	// Writer side of the buffered columns. Copies the current values of every
+	// buffered column into the back buffer and publishes it as the latest
+	// snapshot. Only one thread should call this. It doesn't take the lock, and
+	// it costs a copy of each buffered column. Rows in blocks which are added
+	// after a commit read as zero in snapshots until the next commit.
+	auto commit() -> void {
+		static_assert(has_buffered_columns, "commit requires a column declared with ent::buffered");
+		const auto back  = back_buffer_;
+		with_each_block([back](block_t* block) {
+			(copy_to_snapshot<detail::column_value_t<Ts>>(block, back), ...);
+		});
+		// acq_rel: release publishes the copy we just made, acquire makes sure that
+		// the reader has finished with the buffer we get back.
+		const auto prev = buffer_state_.exchange(static_cast<uint8_t>(back | fresh_bit), std::memory_order_acq_rel);
+		back_buffer_    = static_cast<uint8_t>(prev & buffer_mask);
+	}
+	// Reader side of the buffered columns. Realtime-safe. If there has been a
+	// commit() since the last call then the reader's buffer is swapped for the
+	// latest one. The returned view stays consistent until the next call to
+	// read_committed(). Only one thread should call this.
+	[[nodiscard]]
+	auto read_committed() const -> committed_view {
+		static_assert(has_buffered_columns, "read_committed requires a column declared with ent::buffered");
+		if (buffer_state_.load(std::memory_order_relaxed) & fresh_bit) {
+			const auto prev = buffer_state_.exchange(front_buffer_, std::memory_order_acq_rel);
+			front_buffer_   = static_cast<uint8_t>(prev & buffer_mask);
+		}
+		return committed_view{this, front_buffer_};
+	}
+	// Marks a row of a tracked column as changed. See ent::tracked.
+	template <typename T>
+	auto mark_dirty(size_t idx) -> void {
+		static_assert(is_tracked<T>, "mark_dirty requires a column declared with ent::tracked");
+		const auto lookup = make_lookup(idx);
+		mark_dirty<T>(&get_block(lookup.block), lookup.sub);
+	}
+	// Calls fn(index, T&) for every row of a tracked column which was marked
+	// since the last call, clearing the marks as it goes. The bitmap words are
+	// exchanged atomically, so a row marked while this is running will either
+	// be visited now or next time, never lost. This doesn't take the lock, but
+	// only one thread should consume a given column.
+	template <typename T, typename Fn>
+	auto consume_dirty(Fn&& fn) -> void {
+		static_assert(is_tracked<T>, "consume_dirty requires a column declared with ent::tracked");
+		const auto count = block_count_.load(std::memory_order_acquire);
+		for (size_t b = 0; b < count; ++b) {
+			auto& block  = get_block({b});
+			auto& values = column<T>(&block);
+			auto& dirty  = std::get<column_index<T>>(block.data).dirty;
+			for (size_t w = 0; w < word_count; ++w) {
+				if (!dirty[w].load(std::memory_order_relaxed)) {
+					continue;
+				}
+				auto bits = dirty[w].exchange(0, std::memory_order_acquire);
+				while (bits) {
+					const auto sub = (w * detail::word_bits) + detail::ctz(bits);
+					bits &= bits - 1;
+					fn((b * BlockSize) + sub, values[sub]);
+				}
+			}
+		}
+	}
+	template <typename T> [[nodiscard]]
+	auto get(size_t idx) -> T& {
+		auto lookup = make_lookup(idx);
+		auto& block = get_block(lookup.block);
+		return get<T>(&block, lookup.sub);
+	}
+	template <typename T> [[nodiscard]]
+	auto get(size_t idx) const -> const T& {
+		auto lookup = make_lookup(idx);
+		auto& block = get_block(lookup.block);
+		return get<T>(block, lookup.sub);
+	}
+private:
+	auto add_block() -> void {
+		const auto count = block_count_.load(std::memory_order_relaxed);
+		reserve_directory(count + 1);
+		auto new_block = static_cast<block_t*>(nullptr);
+		if (spare_blocks_.empty()) {
+			new_block = make_block();
+		}
+		else {
+			new_block = spare_blocks_.back();
+			spare_blocks_.pop_back();
+			spare_count_.store(spare_blocks_.size(), std::memory_order_relaxed);
+		}
+		new_block->epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		directory_.load(std::memory_order_relaxed)[count] = new_block;
+		allocator_->publish_block(count, new_block);
+		block_count_.store(count + 1, std::memory_order_release);
+		stats_.add_block();
+		allocator_->publish_state(count + 1, epoch_.load(std::memory_order_relaxed));
+	}
+	auto reserve_spare_blocks(size_t block_count) -> void {
+		spare_blocks_.reserve(block_count);
+		while (spare_blocks_.size() < block_count) {
+			spare_blocks_.push_back(make_block());
+			spare_count_.store(spare_blocks_.size(), std::memory_order_relaxed);
+		}
+		reserve_directory(block_count_.load(std::memory_order_relaxed) + spare_blocks_.size());
+	}
+	[[nodiscard]]
+	auto get_prepared_row_count() const -> size_t {
+		const auto capacity = block_count_.load(std::memory_order_relaxed) * BlockSize;
+		const auto active   = active_count_.load(std::memory_order_relaxed);
+		const auto spare    = spare_count_.load(std::memory_order_relaxed) * BlockSize;
+		return (capacity - std::min(active, capacity)) + spare;
+	}
+	[[nodiscard]]
+	auto make_block() -> block_t* {
+		const auto memory = allocator_->allocate(sizeof(block_t), alignof(block_t));
+		stats_.add_allocation();
+		return new (memory) block_t{};
+	}
+	auto destroy_block(block_t* block) -> void {
+		block->~block_t();
+		allocator_->deallocate(block, sizeof(block_t), alignof(block_t));
+	}
+	auto reserve_directory(size_t capacity) -> void {
+		// NOTE: The old directory is retired rather than deleted because a realtime
+		// reader may have loaded it just before the new one was published. Every
+		// pointer it holds is still valid, so reading from it is harmless. The
+		// directories (at least) double in size so the retired ones add up to less
+		// than the current one.
+		if (capacity <= directory_capacity_) {
+			return;
+		}
+		const auto new_capacity  = std::max(capacity, directory_capacity_ * 2);
+		auto new_directory       = std::make_unique<block_t*[]>(new_capacity);
+		const auto old_directory = directory_.load(std::memory_order_relaxed);
+		std::copy(old_directory, old_directory + block_count_.load(std::memory_order_relaxed), new_directory.get());
+		directory_.store(new_directory.get(), std::memory_order_release);
+		directories_.push_back(std::move(new_directory));
+		directory_capacity_ = new_capacity;
+	}
+	auto erase_blocks() -> void {
+		if (block_count_.load(std::memory_order_relaxed) > 0) {
+			allocator_->publish_state(0, epoch_.load(std::memory_order_relaxed));
+		}
+		with_each_block([this](block_t* block) { destroy_block(block); });
+		for (const auto block : spare_blocks_) {
+			destroy_block(block);
+		}
+		spare_blocks_.clear();
+		spare_count_.store(0, std::memory_order_relaxed);
+	}
+	template <typename Fn>
+	auto with_each_block(Fn&& fn) -> void {
+		// Count first: whichever directory we load after it holds at least that
+		// many blocks (see get_block().)
+		const auto count     = block_count_.load(std::memory_order_acquire);
+		const auto directory = directory_.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i) {
+			fn(directory[i]);
+		}
+	}
+	auto get_block(block_index idx) -> block_t& {
+		// NOTE: This looks like a data race. But it is not!
+		// Blocks are never moved or freed while the table is alive, and a block's
+		// pointer is written into the directory before the directory is published
+		// and before block_count_ is incremented (both with release semantics.) As
+		// long as the index being passed in was valid when this function was called,
+		// whichever directory we load here already contains the pointer we need, and
+		// we never read a slot which is being written concurrently.
+		return *directory_.load(std::memory_order_acquire)[idx.value];
+	}
+	auto get_block(block_index idx) const -> const block_t& {
+		return *directory_.load(std::memory_order_acquire)[idx.value];
+	}
+	[[nodiscard]] static constexpr
+	auto valid_bits(size_t word) -> detail::word_t {
+		if ((word + 1) * detail::word_bits <= BlockSize) {
+			return ~detail::word_t{0};
+		}
+		return (detail::word_t{1} << (BlockSize % detail::word_bits)) - 1;
+	}
+	[[nodiscard]] static
+	auto claim_row(block_t* block) -> std::optional<sub_index> {
+		for (size_t w = 0; w < word_count; ++w) {
+			auto& word = block->occupied[w];
+			auto bits  = word.load(std::memory_order_relaxed);
+			for (;;) {
+				const auto free = ~bits & valid_bits(w);
+				if (!free) {
+					break;
+				}
+				const auto bit = free & (~free + 1);
+				// Acquire pairs with the release in free_claimed_row() so that we see
+				// the reset values of a row which was just released by another thread.
+				if (word.compare_exchange_weak(bits, bits | bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+					return sub_index{(w * detail::word_bits) + detail::ctz(bit)};
+				}
+			}
+		}
+		return std::nullopt;
+	}
+	[[nodiscard]]
+	auto claim_free_index() -> std::optional<size_t> {
+		// NOTE: The search hint is only a hint. It can be stale in either direction
+		// so after searching from the hint to the end we wrap around and search the
+		// blocks before it too. This guarantees that we only report the table as
+		// full if every row really was in use at some point during the search.
+		const auto count = block_count_.load(std::memory_order_acquire);
+		const auto hint  = std::min(search_hint_.load(std::memory_order_relaxed), count);
+		for (size_t i = 0; i < count; ++i) {
+			const auto b = (hint + i) % count;
+			auto& block = get_block({b});
+			if (!refresh_block(&block, false)) {
+				continue;
+			}
+			if (const auto sub = claim_row(&block)) {
+				block.generations[sub->value].fetch_add(1, std::memory_order_relaxed);
+				stats_.update_peak(active_count_.fetch_add(1, std::memory_order_relaxed) + 1);
+				stats_.add_acquires(1);
+				stats_.add_search_depth(i + 1);
+				if (b != hint) {
+					search_hint_.store(b, std::memory_order_relaxed);
+				}
+				return (b * BlockSize) + sub->value;
+			}
+		}
+		stats_.add_search_depth(count);
+		return std::nullopt;
+	}
+	// Claims up to max_count rows, taking as many bits from each bitmap word as
+	// possible with a single CAS. Returns the number of rows claimed. from_lock
+	// is passed on to refresh_block().
+	template <typename OutIt>
+	auto claim_free_indices(size_t max_count, OutIt& out, bool from_lock) -> size_t {
+		size_t claimed = 0;
+		const auto count = block_count_.load(std::memory_order_acquire);
+		for (size_t b = 0; b < count && claimed < max_count; ++b) {
+			auto& block = get_block({b});
+			if (!refresh_block(&block, from_lock)) {
+				continue;
+			}
+			for (size_t w = 0; w < word_count && claimed < max_count; ++w) {
+				auto& word = block.occupied[w];
+				auto bits  = word.load(std::memory_order_relaxed);
+				auto take  = detail::word_t{0};
+				for (;;) {
+					auto free = ~bits & valid_bits(w);
+					take      = 0;
+					for (size_t n = claimed; free && n < max_count; ++n) {
+						const auto bit = free & (~free + 1);
+						take |= bit;
+						free &= ~bit;
+					}
+					if (!take || word.compare_exchange_weak(bits, bits | take, std::memory_order_acquire, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				claimed += detail::popcount(take);
+				stats_.update_peak(active_count_.fetch_add(detail::popcount(take), std::memory_order_relaxed) + detail::popcount(take));
+				stats_.add_acquires(detail::popcount(take));
+				while (take) {
+					const auto sub = (w * detail::word_bits) + detail::ctz(take);
+					take &= take - 1;
+					block.generations[sub].fetch_add(1, std::memory_order_relaxed);
+					*out++ = (b * BlockSize) + sub;
+				}
+			}
+		}
+		return claimed;
+	}
+	template <typename T, typename Range>
+	auto reset_runs(const Range& indices) -> void {
+		auto run_begin = size_t{0};
+		auto run_end   = size_t{0};
+		const auto flush = [this, &run_begin, &run_end] {
+			if (run_end > run_begin) {
+				const auto lookup = make_lookup(run_begin);
+				auto& block       = get_block(lookup.block);
+				reset_values<T>(&block, lookup.sub, run_end - run_begin);
+				for (auto sub = lookup.sub.value; sub < lookup.sub.value + (run_end - run_begin); ++sub) {
+					mark_dirty<T>(&block, {sub});
+				}
+			}
+		};
+		for (const auto elem_index : indices) {
+			if (elem_index == run_end && run_end > run_begin && (elem_index % BlockSize) != 0) {
+				run_end++;
+				continue;
+			}
+			flush();
+			run_begin = elem_index;
+			run_end   = elem_index + 1;
+		}
+		flush();
+	}
+	template <typename Fn, typename... Ptrs> static
+	auto visit_block(size_t base, Fn& fn, Ptrs... columns) -> void {
+		visit_range(base, 0, BlockSize, fn, columns...);
+	}
+	template <typename Fn, typename... Ptrs> static
+	auto visit_range(size_t base, size_t begin, size_t end, Fn& fn, Ptrs... columns) -> void {
+		for (size_t i = begin; i < end; ++i) {
+			fn(base + i, columns[i]...);
+		}
+	}
+	// Calls fn(block, base_elem_index) for every block until fn returns true.
+	template <typename Self, typename Fn> static
+	auto scan_blocks(Self& self, Fn&& fn) -> void {
+		const auto count = self.block_count_.load(std::memory_order_acquire);
+		for (size_t b = 0; b < count; ++b) {
+			if (fn(self.get_block({b}), b * BlockSize)) {
+				return;
+			}
+		}
+	}
+	// Calls fn(block, elem_index, sub_index) for every acquired row until fn
+	// returns true. Returns true if it was stopped early.
+	template <typename Self, typename Fn> static
+	auto scan_active(Self& self, Fn&& fn) -> bool {
+		const auto count = self.block_count_.load(std::memory_order_acquire);
+		for (size_t b = 0; b < count; ++b) {
+			auto& block = self.get_block({b});
+			if (!self.is_current(block)) {
+				continue;
+			}
+			for (size_t w = 0; w < word_count; ++w) {
+				auto bits = block.occupied[w].load(std::memory_order_acquire);
+				while (bits) {
+					const auto sub = (w * detail::word_bits) + detail::ctz(bits);
+					bits &= bits - 1;
+					if (fn(block, (b * BlockSize) + sub, sub_index{sub})) {
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+	template <typename Array> [[nodiscard]] static
+	auto as_bytes(Array& array) -> ent::span<std::conditional_t<std::is_const_v<Array>, const std::byte, std::byte>> {
+		return {reinterpret_cast<std::conditional_t<std::is_const_v<Array>, const std::byte*, std::byte*>>(array.data()), sizeof(array)};
+	}
+	auto clear_all() -> void {
+		with_each_block([this](block_t* block) {
+			clear_block(block);
+			free_all_rows(block);
+			block->epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_release);
+		});
+		active_count_.store(0, std::memory_order_release);
+		search_hint_.store(0, std::memory_order_relaxed);
+		(clear_index<detail::column_value_t<Ts>>(), ...);
+		drop_pool();
+	}
+	// Calls fn(data, count, elem_index, occupied) for every word of the
+	// occupancy bitmaps of the current blocks which has any acquired rows, where
+	// data points at the column values of the word's count rows, until fn
+	// returns true.
+	template <typename T, typename Fn>
+	auto scan_words(Fn&& fn) const -> void {
+		const auto count = block_count_.load(std::memory_order_acquire);
+		for (size_t b = 0; b < count; ++b) {
+			const auto& block = get_block({b});
+			if (!is_current(block)) {
+				continue;
+			}
+			const auto data = column<T>(block).data();
+			for (size_t w = 0; w < word_count; ++w) {
+				const auto occupied = block.occupied[w].load(std::memory_order_acquire);
+				if (!occupied) {
+					continue;
+				}
+				const auto first = w * detail::word_bits;
+				if (fn(data + first, std::min(detail::word_bits, BlockSize - first), (b * BlockSize) + first, occupied)) {
+					return;
+				}
+			}
+		}
+	}
+	// Calls fn(elem_index, bits) for every word with matching acquired rows
+	// until fn returns true.
+	template <typename T, typename Fn>
+	auto scan_compare(ent::cmp op, const T& value, Fn&& fn) const -> void {
+		detail::dispatch(op, [this, &value, &fn](auto op_) {
+			scan_words<T>([&value, &fn](const T* data, size_t count, size_t base, detail::word_t occupied) {
+				const auto bits = detail::compare_word<decltype(op_)::value>(data, count, value) & occupied;
+				return bits && fn(base, bits);
+			});
+		});
+	}
+	template <detail::reduction R, typename T> [[nodiscard]]
+	auto reduce(std::optional<T> acc) const -> std::optional<T> {
+		scan_words<T>([&acc](const T* data, size_t count, size_t, detail::word_t occupied) {
+			const auto full = count == detail::word_bits ? ~detail::word_t{0} : (detail::word_t{1} << count) - 1;
+			if (occupied == full) {
+				acc = detail::reduce_run<R>(data, count, acc ? *acc : data[0]);
+				return false;
+			}
+			while (occupied) {
+				const auto& value = data[detail::ctz(occupied)];
+				acc = acc ? detail::combine<R>(*acc, value) : value;
+				occupied &= occupied - 1;
+			}
+			return false;
+		});
+		return acc;
 	}
 	[[nodiscard]] static
-	auto get(const block_t& block, sub_index idx) -> const_row_t {
-		return std::apply([idx](auto&... args) {
-			return std::make_tuple(args[idx]...);
-		}, block.data);
-	}
-	static auto reset(block_t* block, sub_index idx) -> void                                             { (reset<Ts>(block, idx), ...); }
-	static auto clear_block(block_t* block) -> void                                                      { for (size_t i = 0; i < BlockSize; ++i) { reset(block, {i}); } }
-	template <typename T> [[nodiscard]] static auto get(block_t* block, sub_index idx) -> T&             { return std::get<column_t<T>>(block->data)[idx.value]; }
-	template <typename T> [[nodiscard]] static auto get(const block_t& block, sub_index idx) -> const T& { return std::get<column_t<T>>(block.data)[idx.value]; }
-	template <typename T> auto set(block_t* block, sub_index idx, T&& value) -> T&                       { return get<std::decay_t<T>>(block, idx) = std::forward<T>(value); }
-	template <typename T> static auto reset(block_t* block, sub_index idx) -> void                       { get<T>(block, idx) = T{}; }
-public:
-	table() = default;
-	table(const table&) = delete;
-	table& operator=(const table&) = delete;
-	table(table&& other) noexcept
-		: first_{other.first_}
-		, last_{other.last_}
-		, block_count_{other.block_count_}
-		, free_indices_{std::move(other.free_indices_)}
-	{
-		other.first_ = nullptr;
-		other.last_  = nullptr;
-		other.block_count_ = 0;
+	auto generation(const block_t& block, sub_index sub) -> uint32_t {
+		return block.generations[sub.value].load(std::memory_order_relaxed);
 	}
-	table& operator=(table&& other) noexcept {
-		if (this != &other) {
-			erase_blocks();
-			first_        = other.first_;
-			last_         = other.last_;
-			free_indices_ = std::move(other.free_indices_);
-			block_count_.store(other.block_count_.load());
-			other.first_  = nullptr;
-			other.last_   = nullptr;
-			other.block_count_ = 0;
+	// Returns the first free row at or after elem_index, or end if there isn't
+	// one before end.
+	[[nodiscard]]
+	auto find_free_row(size_t elem_index, size_t end) const -> size_t {
+		while (elem_index < end) {
+			const auto lookup = make_lookup(elem_index);
+			const auto w      = lookup.sub.value / detail::word_bits;
+			const auto shift  = lookup.sub.value % detail::word_bits;
+			const auto free   = ~get_block(lookup.block).occupied[w].load(std::memory_order_relaxed) & valid_bits(w) & (~detail::word_t{0} << shift);
+			if (free) {
+				return std::min(end, elem_index - shift + detail::ctz(free));
+			}
+			elem_index = (lookup.block.value * BlockSize) + ((w + 1) * detail::word_bits);
+			elem_index = std::min(elem_index, (lookup.block.value + 1) * BlockSize);
 		}
-		return *this;
+		return end;
 	}
-	~table() { erase_blocks(); }
+	// Returns the last occupied row before elem_index, or the capacity of the
+	// table if there isn't one.
 	[[nodiscard]]
-	auto acquire(ent::lock_t) -> size_t {
-		const auto lock = std::lock_guard{mutex_};
-		if (free_indices_.empty()) {
-			free_indices_.resize(BlockSize);
-			std::iota(free_indices_.rbegin(), free_indices_.rend(), BlockSize * block_count_);
-			add_block();
+	auto find_occupied_row_before(size_t elem_index) const -> size_t {
+		while (elem_index > 0) {
+			const auto lookup = make_lookup(elem_index - 1);
+			const auto w      = lookup.sub.value / detail::word_bits;
+			const auto bit    = lookup.sub.value % detail::word_bits;
+			const auto mask   = bit == detail::word_bits - 1 ? ~detail::word_t{0} : (detail::word_t{1} << (bit + 1)) - 1;
+			const auto bits   = get_block(lookup.block).occupied[w].load(std::memory_order_relaxed) & mask;
+			const auto first  = (lookup.block.value * BlockSize) + (w * detail::word_bits);
+			if (bits) {
+				return first + detail::highest_bit(bits);
+			}
+			elem_index = first;
 		}
-		return pop_free_index();
+		return get_capacity();
 	}
-	auto release(ent::lock_t, size_t elem_index) -> void {
-		const auto lock   = std::lock_guard{mutex_};
+	// Moves the values of an acquired row into a free row, leaving the old
+	// row reset and free.
+	auto move_row(size_t from_index, size_t to_index) -> void {
+		const auto from = make_lookup(from_index);
+		const auto to   = make_lookup(to_index);
+		auto& from_block = get_block(from.block);
+		auto& to_block   = get_block(to.block);
+		unindex_row(from_index);
+		((get<detail::column_value_t<Ts>>(&to_block, to.sub) = std::move(get<detail::column_value_t<Ts>>(&from_block, from.sub))), ...);
+		(mark_dirty<detail::column_value_t<Ts>>(&to_block, to.sub), ...);
+		reset(&from_block, from.sub);
+		const auto bit = [](sub_index sub) { return detail::word_t{1} << (sub.value % detail::word_bits); };
+		to_block.generations[to.sub.value].fetch_add(1, std::memory_order_relaxed);
+		to_block.occupied[to.sub.value / detail::word_bits].fetch_or(bit(to.sub), std::memory_order_release);
+		from_block.generations[from.sub.value].fetch_add(1, std::memory_order_relaxed);
+		from_block.occupied[from.sub.value / detail::word_bits].fetch_and(~bit(from.sub), std::memory_order_release);
+		index_row(to_index);
+	}
+	// Returns the row's value, or nullptr if the row is not acquired.
+	template <typename T> [[nodiscard]]
+	auto indexed_value(size_t elem_index) const -> const T* {
+		if (elem_index >= get_capacity()) {
+			return nullptr;
+		}
 		const auto lookup = make_lookup(elem_index);
-		auto& block       = get_block(lookup.block);
-		reset(&block, lookup.sub);
-		free_indices_.push_back(elem_index);
+		const auto& block = get_block(lookup.block);
+		const auto bit    = detail::word_t{1} << (lookup.sub.value % detail::word_bits);
+		if (!is_current(block) || !(block.occupied[lookup.sub.value / detail::word_bits].load(std::memory_order_acquire) & bit)) {
+			return nullptr;
+		}
+		return &get<T>(block, lookup.sub);
 	}
-	auto release_no_reset(ent::lock_t, size_t elem_index) -> void {
-		const auto lock = std::lock_guard{mutex_};
-		free_indices_.push_back(elem_index);
+	auto index_row(size_t elem_index) -> void   { (index_row<detail::column_value_t<Ts>>(elem_index), ...); }
+	auto unindex_row(size_t elem_index) -> void { (unindex_row<detail::column_value_t<Ts>>(elem_index), ...); }
+	template <typename T> auto index_row(size_t elem_index) -> void {
+		if constexpr (is_indexed<T> || is_ordered<T>) {
+			const auto value = indexed_value<T>(elem_index);
+			if (!value) {
+				return;
+			}
+			const auto value_of = [this](size_t row) { return indexed_value<T>(row); };
+			if constexpr (is_indexed<T>) {
+				std::get<column_index<T>>(indexes_).insert(elem_index, *value, value_of);
+			}
+			if constexpr (is_ordered<T>) {
+				std::get<column_index<T>>(ordered_indexes_).insert(elem_index, *value, value_of);
+			}
+		}
 	}
-	auto clear(ent::lock_t) -> void {
-		const auto lock = std::lock_guard{mutex_};
-		with_each_block([](block_t* block) { clear_block(block); });
-		free_indices_.resize(BlockSize * block_count_);
-		std::iota(free_indices_.rbegin(), free_indices_.rend(), 0);
+	template <typename T> auto unindex_row(size_t elem_index) -> void {
+		if constexpr (is_indexed<T>) {
+			std::get<column_index<T>>(indexes_).erase(elem_index, get<T>(elem_index));
+		}
+		if constexpr (is_ordered<T>) {
+			std::get<column_index<T>>(ordered_indexes_).erase(elem_index, get<T>(elem_index));
+		}
+	}
+	template <typename T> auto clear_index() -> void {
+		if constexpr (is_indexed<T>) {
+			std::get<column_index<T>>(indexes_).clear();
+		}
+		if constexpr (is_ordered<T>) {
+			std::get<column_index<T>>(ordered_indexes_).clear();
+		}
 	}
+	// Takes the lock, timing it if ENT_STATS is defined.
+#if defined(ENT_STATS)
 	[[nodiscard]]
-	auto get_capacity() const -> size_t {
-		return (block_count_ * BlockSize);
+	auto lock_mutex() const -> detail::timed_lock {
+		return detail::timed_lock{mutex_, stats_};
 	}
+#else
 	[[nodiscard]]
-	auto get_active_row_count(ent::lock_t) const -> size_t {
-		const auto lock = std::lock_guard{mutex_};
-		return (block_count_ * BlockSize) - free_indices_.size();
+	auto lock_mutex() const -> std::lock_guard<std::mutex> {
+		return std::lock_guard{mutex_};
 	}
-	template <typename T, typename PredFn> [[nodiscard]]
-	auto find(ent::lock_t, PredFn&& pred) -> std::optional<size_t> {
-		const auto lock = std::lock_guard{mutex_};
-		for (size_t i = 0; i < get_capacity(); ++i) {
-			if (pred(get<T>(i))) {
-				return i;
-			}
+#endif
+	[[nodiscard]]
+	auto is_current(const block_t& block) const -> bool {
+		return block.epoch.load(std::memory_order_acquire) == epoch_.load(std::memory_order_acquire);
+	}
+	// Brings a block which was left stale by clear_lazy() up to date, by
+	// resetting its columns and releasing every row in it. Returns false if
+	// another thread is already doing that, in which case the block should be
+	// skipped for now. If from_lock is false then this was called from a
+	// realtime thread so we stick to plain memset rather than asking the
+	// allocator to zero the memory (which might mean a syscall.)
+	auto refresh_block(block_t* block, bool from_lock) -> bool {
+		const auto epoch = epoch_.load(std::memory_order_acquire);
+		auto block_epoch = block->epoch.load(std::memory_order_acquire);
+		if (block_epoch == epoch) {
+			return true;
 		}
-		return std::nullopt;
+		if (block_epoch == refreshing_epoch || !block->epoch.compare_exchange_strong(block_epoch, refreshing_epoch, std::memory_order_acquire)) {
+			return block->epoch.load(std::memory_order_acquire) == epoch;
+		}
+		if (from_lock) {
+			clear_block(block);
+		}
+		else {
+			(reset_values<detail::column_value_t<Ts>>(block, {0}, BlockSize), ...);
+			mark_all_dirty(block);
+		}
+		free_all_rows(block);
+		block->epoch.store(epoch, std::memory_order_release);
+		return true;
 	}
-	template <typename Fn>
-	auto visit(ent::lock_t, Fn&& fn) -> void {
-		const auto lock     = std::lock_guard{mutex_};
-		const auto capacity = block_count_ * BlockSize;
-		for (size_t i = 0; i < capacity; ++i) {
-			fn(i);
+	// Clears the occupancy bitmap, bumping the generations of the rows which
+	// were occupied. Doesn't touch active_count_.
+	static auto free_all_rows(block_t* block) -> void {
+		for (size_t w = 0; w < word_count; ++w) {
+			auto bits = block->occupied[w].exchange(0, std::memory_order_release);
+			while (bits) {
+				block->generations[(w * detail::word_bits) + detail::ctz(bits)].fetch_add(1, std::memory_order_relaxed);
+				bits &= bits - 1;
+			}
 		}
 	}
-	template <typename T, typename Fn>
-	auto visit(ent::lock_t, Fn&& fn) -> void {
-		const auto lock     = std::lock_guard{mutex_};
-		const auto capacity = block_count_ * BlockSize;
-		for (size_t i = 0; i < capacity; ++i) {
-			fn(i, get<T>(i));
+	// release(ent::lock, handle) with the lock already held.
+	auto release_locked(handle h) -> bool {
+		if (h.index() >= get_capacity()) {
+			return false;
 		}
+		const auto lookup = make_lookup(h.index());
+		auto& block       = get_block(lookup.block);
+		if (!claim_release(&block, lookup.sub, h.generation())) {
+			return false;
+		}
+		unindex_row(h.index());
+		reset(&block, lookup.sub);
+		free_claimed_row(&block, lookup);
+		return true;
 	}
-	template <typename T, typename Fn>
-	auto visit(ent::lock_t, Fn&& fn) const -> void {
-		const auto lock     = std::lock_guard{mutex_};
-		const auto capacity = block_count_ * BlockSize;
-		for (size_t i = 0; i < capacity; ++i) {
-			fn(i, get<T>(i));
+	// Does nothing if the row isn't acquired.
+	auto free_row(block_t* block, lookup_t lookup) -> void {
+		if (claim_release(block, lookup.sub, generation(*block, lookup.sub))) {
+			free_claimed_row(block, lookup);
 		}
 	}
+	// Moves the row's generation from the given odd value to the next even
+	// one. This is what makes releasing a row atomic: when several threads
+	// release the same row (or handle) at once, only one of them wins and goes
+	// on to reset it and call free_claimed_row(). The generation has to become
+	// even before the row's bit is cleared, otherwise a thread which claims the
+	// row again straight away could make a handle with an even generation.
 	[[nodiscard]]
-	auto get(size_t idx) -> row_t {
-		auto lookup = make_lookup(idx);
-		auto& block = get_block(lookup.block);
-		return get(&block, lookup.sub);
+	auto claim_release(block_t* block, sub_index sub, uint32_t expected) const -> bool {
+		if (!(expected & 1) || !is_current(*block)) {
+			return false;
+		}
+		return block->generations[sub.value].compare_exchange_strong(expected, expected + 1, std::memory_order_relaxed);
+	}
+	auto free_claimed_row(block_t* block, lookup_t lookup) -> void {
+		const auto word = lookup.sub.value / detail::word_bits;
+		const auto bit  = detail::word_t{1} << (lookup.sub.value % detail::word_bits);
+		const auto prev = block->occupied[word].fetch_and(~bit, std::memory_order_release);
+		if (!(prev & bit)) {
+			return;
+		}
+		active_count_.fetch_sub(1, std::memory_order_relaxed);
+		stats_.add_release();
+		if (lookup.block.value < search_hint_.load(std::memory_order_relaxed)) {
+			search_hint_.store(lookup.block.value, std::memory_order_relaxed);
+		}
+	}
+	auto make_lookup(size_t elem_index) const -> lookup_t {
+		if (elem_index >= get_capacity()) {
+			throw std::out_of_range("Element index out of range");
+		}
+		return {{elem_index / BlockSize}, {elem_index % BlockSize}};
+	}
+	ent::allocator*                            allocator_          = &default_allocator();
+	std::vector<block_t*>                      spare_blocks_;
+	std::atomic<size_t>                        spare_count_        = 0;
+	std::atomic<size_t>                        low_water_mark_     = 0;
+	std::atomic<block_t**>                     directory_          = nullptr;
+	size_t                                     directory_capacity_ = 0;
+	std::vector<std::unique_ptr<block_t*[]>>   directories_;
+	std::atomic<size_t>                        block_count_        = 0;
+	std::atomic<size_t>                        active_count_       = 0;
+	std::atomic<size_t>                        search_hint_        = 0;
+	std::atomic<uint64_t>                      epoch_              = 0;
+	// The number of local_caches which may hold rows. They are tied to this
+	// table's address, so this isn't moved with the blocks.
+	std::atomic<size_t>                        holding_caches_     = 0;
+	// Triple buffer state for buffered columns. buffer_state_ holds the index of
+	// the latest snapshot plus a flag saying whether the reader has seen it.
+	static constexpr uint8_t buffer_mask = 0x3;
+	static constexpr uint8_t fresh_bit   = 0x4;
+	mutable std::atomic<uint8_t>               buffer_state_       = 1;
+	uint8_t                                    back_buffer_        = 2;
+	mutable uint8_t                            front_buffer_       = 0;
+	std::tuple<detail::index_t<Ts>...>         indexes_;
+	std::tuple<detail::ordered_index_t<Ts>...> ordered_indexes_;
+	mutable std::mutex                         mutex_;
+	mutable detail::stats_counters             stats_;
+	std::unique_ptr<deferred_t>                deferred_;
+};
+
+// Columns are declared as plain types, as column policies (e.g.
+// ent::aligned<T>) or as groups of columns (ent::group<Ts...>).
+template <size_t BlockSize, typename... Ts>
+using table = typename detail::apply_columns<basic_table, BlockSize, typename detail::concat_columns<typename detail::expand_column<Ts>::type...>::type>::type;
+
+// Lets an ent::table live in memory which is shared with other processes
+// (e.g. an ent::shared_memory mapping, or anything else you map at
+// different addresses in each process.) The region is formatted as a header,
+// a directory of block offsets from the start of the region, and space for
+// as many blocks as fit, so nothing in it depends on where it is mapped.
+// Give this to exactly one table as its allocator, and use ent::shared_view
+// in the other processes to read the table. Every column type must be
+// trivially copyable, and the table can't have more blocks than fit in the
+// region (acquire() throws std::bad_alloc instead.) Indexes of indexed and
+// ordered columns stay in the writing process.
+//   using voices_t = ent::table<512, Voice, float>;
+//   auto memory    = ent::shared_memory::create("/voices", ent::shared_allocator<voices_t>::region_size(8));
+//   auto allocator = ent::shared_allocator<voices_t>{memory.get_bytes()};
+//   auto voices    = voices_t{allocator};
+template <typename Table>
+struct shared_allocator : allocator {
+	explicit shared_allocator(ent::span<std::byte> region)
+		: base_{region.data()}
+		, max_blocks_{max_blocks_for(region.size())}
+	{
+		if (reinterpret_cast<uintptr_t>(region.data()) % alignof(block_t) != 0) {
+			throw std::invalid_argument("Shared region is not aligned for the table's blocks");
+		}
+		if (region.size() < region_size(1)) {
+			throw std::invalid_argument("Shared region is too small for a block");
+		}
+		header_ = new (base_) detail::shared_header{};
+		header_->version     = detail::shared_header::current_version;
+		header_->layout      = Table::layout_hash();
+		header_->block_bytes = sizeof(block_t);
+		header_->max_blocks  = max_blocks_;
+		header_->first_block = first_block_offset(max_blocks_);
+		offsets_ = new (base_ + sizeof(detail::shared_header)) std::atomic<uint64_t>[max_blocks_]{};
+		// Readers which attach from now on see a complete header.
+		header_->magic.store(detail::shared_header::magic_value, std::memory_order_release);
+	}
+	shared_allocator(const shared_allocator&) = delete;
+	shared_allocator& operator=(const shared_allocator&) = delete;
+	// The number of bytes needed for a table of up to max_blocks blocks.
+	[[nodiscard]] static constexpr
+	auto region_size(size_t max_blocks) -> size_t {
+		return first_block_offset(max_blocks) + (max_blocks * sizeof(block_t));
 	}
 	[[nodiscard]]
-	auto get(size_t idx) const -> const_row_t {
-		auto lookup = make_lookup(idx);
-		auto& block = get_block(lookup.block);
-		return get(block, lookup.sub);
+	auto get_max_blocks() const -> size_t { return max_blocks_; }
+	[[nodiscard]]
+	auto allocate(size_t size, size_t alignment) -> void* override {
+		if (size != sizeof(block_t) || alignment > alignof(block_t)) {
+			throw std::bad_alloc{};
+		}
+		auto slot = next_slot_;
+		if (!free_slots_.empty()) {
+			slot = free_slots_.back();
+			free_slots_.pop_back();
+		}
+		else if (next_slot_ < max_blocks_) {
+			next_slot_++;
+		}
+		else {
+			throw std::bad_alloc{};
+		}
+		return base_ + header_->first_block + (slot * sizeof(block_t));
 	}
-	template <typename T>
-	auto set(size_t idx, T&& value) -> T& {
-		auto lookup = make_lookup(idx);
-		auto& block = get_block(lookup.block);
-		return set(&block, lookup.sub, std::forward<T>(value));
+	auto deallocate(void* ptr, size_t, size_t) -> void override {
+		free_slots_.push_back((static_cast<std::byte*>(ptr) - base_ - header_->first_block) / sizeof(block_t));
 	}
-	template <typename T> [[nodiscard]]
-	auto get(size_t idx) -> T& {
-		auto lookup = make_lookup(idx);
-		auto& block = get_block(lookup.block);
-		return get<T>(&block, lookup.sub);
+	auto publish_block(size_t index, const void* block) -> void override {
+		// Ordered by the release store of the block count which follows.
+		offsets_[index].store(static_cast<uint64_t>(static_cast<const std::byte*>(block) - base_), std::memory_order_relaxed);
 	}
-	template <typename T> [[nodiscard]]
-	auto get(size_t idx) const -> const T& {
-		auto lookup = make_lookup(idx);
-		auto& block = get_block(lookup.block);
-		return get<T>(block, lookup.sub);
+	auto publish_state(size_t block_count, uint64_t epoch) -> void override {
+		header_->epoch.store(epoch, std::memory_order_release);
+		header_->block_count.store(block_count, std::memory_order_release);
 	}
 private:
-	auto add_block() -> void {
-		const auto new_block = new block_t;
-		if (!first_) { first_ = new_block; }
-		if (last_) { last_->next = new_block; }
-		last_ = new_block;
-		block_count_++;
+	using block_t = typename Table::block_t;
+	static_assert(Table::has_trivial_columns, "Only tables with trivially copyable columns can be shared");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free, "Shared tables need lock-free atomics");
+	[[nodiscard]] static constexpr
+	auto first_block_offset(size_t max_blocks) -> size_t {
+		const auto directory_end = sizeof(detail::shared_header) + (max_blocks * sizeof(std::atomic<uint64_t>));
+		return (directory_end + alignof(block_t) - 1) / alignof(block_t) * alignof(block_t);
 	}
-	auto erase_blocks() -> void {
-		with_each_block([](block_t* block) { delete block; });
+	[[nodiscard]] static constexpr
+	auto max_blocks_for(size_t size) -> size_t {
+		auto blocks = size / (sizeof(block_t) + sizeof(std::atomic<uint64_t>));
+		while (blocks > 0 && region_size(blocks) > size) {
+			blocks--;
+		}
+		return blocks;
 	}
-	template <typename Fn>
-	auto with_each_block(Fn&& fn) -> void {
-		auto block = first_;
-		while (block) {
-			const auto next = block->next;
-			fn(block);
-			block = next;
+	std::byte*               base_;
+	detail::shared_header*   header_     = nullptr;
+	std::atomic<uint64_t>*   offsets_    = nullptr;
+	size_t                   max_blocks_;
+	size_t                   next_slot_  = 0;
+	std::vector<size_t>      free_slots_;
+};
+
+// Reads a table whose blocks were allocated by an ent::shared_allocator,
+// typically from another process. Table must be the same table type (this is
+// checked, as far as the sizes of the columns and blocks go.) Everything here
+// is realtime-safe, and gives the same guarantees as the corresponding
+// functions of the table itself: a row which is acquired (as far as this
+// process can tell) can be read, but it's up to you to coordinate with the
+// process which writes or releases it.
+template <typename Table>
+struct shared_view {
+	explicit shared_view(ent::span<const std::byte> region)
+		: base_{region.data()}
+		, header_{reinterpret_cast<const detail::shared_header*>(region.data())}
+	{
+		if (region.size() < sizeof(detail::shared_header) || header_->magic.load(std::memory_order_acquire) != detail::shared_header::magic_value) {
+			throw std::invalid_argument("Not a shared table region");
+		}
+		if (header_->version != detail::shared_header::current_version) {
+			throw std::invalid_argument("Unsupported shared table version");
 		}
+		if (header_->layout != Table::layout_hash() || header_->block_bytes != sizeof(block_t)) {
+			throw std::invalid_argument("Shared table has a different layout");
+		}
+		if (region.size() < header_->first_block + (header_->max_blocks * sizeof(block_t))) {
+			throw std::invalid_argument("Shared region is truncated");
+		}
+		offsets_ = reinterpret_cast<const std::atomic<uint64_t>*>(base_ + sizeof(detail::shared_header));
 	}
-	auto get_block(block_index idx) -> block_t& {
-		// NOTE: This looks like a data race. But it is not!
-		// As long as the index being passed in was valid when this function was called,
-		// the loop will exit before reading the 'next' field of any contended blocks.
-		// If you are having a hard time grasping that then consider what happens if
-		// idx == 0 (the body of the loop is not run.)
-		auto block = first_;
-		for (size_t i = 0; i < idx.value; ++i) { block = block->next; }
-		return *block;
+	[[nodiscard]]
+	auto get_block_count() const -> size_t { return static_cast<size_t>(header_->block_count.load(std::memory_order_acquire)); }
+	[[nodiscard]]
+	auto get_capacity() const -> size_t { return get_block_count() * block_size; }
+	template <typename T> [[nodiscard]]
+	auto get(size_t idx) const -> const T& {
+		const auto lookup = make_lookup(idx);
+		return Table::template get<T>(get_block(lookup.block), lookup.sub);
+	}
+	[[nodiscard]]
+	auto get_handle(size_t elem_index) const -> handle {
+		const auto lookup = make_lookup(elem_index);
+		return handle::make(elem_index, Table::generation(get_block(lookup.block), lookup.sub));
+	}
+	[[nodiscard]]
+	auto is_alive(handle h) const -> bool {
+		if (h.index() >= get_capacity()) {
+			return false;
+		}
+		const auto lookup = make_lookup(h.index());
+		const auto& block = get_block(lookup.block);
+		return Table::generation(block, lookup.sub) == h.generation() && is_current(block);
+	}
+	// Calls fn(elem_index, const Cs&...) for every acquired row.
+	template <typename... Cs, typename Fn>
+	auto visit_active(Fn&& fn) const -> void {
+		const auto count = get_block_count();
+		for (size_t b = 0; b < count; ++b) {
+			const auto& block = get_block({b});
+			if (!is_current(block)) {
+				continue;
+			}
+			for (size_t w = 0; w < Table::word_count; ++w) {
+				auto bits = block.occupied[w].load(std::memory_order_acquire);
+				while (bits) {
+					const auto sub = (w * detail::word_bits) + detail::ctz(bits);
+					bits &= bits - 1;
+					fn((b * block_size) + sub, Table::template get<Cs>(block, {sub})...);
+				}
+			}
+		}
 	}
+private:
+	using block_t     = typename Table::block_t;
+	using block_index = typename Table::block_index;
+	using sub_index   = typename Table::sub_index;
+	using lookup_t    = typename Table::lookup_t;
+	static constexpr size_t block_size = Table::rows_per_block;
+	[[nodiscard]]
 	auto get_block(block_index idx) const -> const block_t& {
-		auto block = first_;
-		for (size_t i = 0; i < idx.value; ++i) { block = block->next; }
-		return *block;
+		// The offset was stored before the block count was published, just like
+		// the table's own directory.
+		return *reinterpret_cast<const block_t*>(base_ + offsets_[idx.value].load(std::memory_order_relaxed));
 	}
-	auto pop_free_index() -> size_t {
-		const auto index = free_indices_.back();
-		free_indices_.pop_back();
-		return index;
+	[[nodiscard]]
+	auto is_current(const block_t& block) const -> bool {
+		return block.epoch.load(std::memory_order_acquire) == header_->epoch.load(std::memory_order_acquire);
 	}
+	[[nodiscard]]
 	auto make_lookup(size_t elem_index) const -> lookup_t {
 		if (elem_index >= get_capacity()) {
 			throw std::out_of_range("Element index out of range");
 		}
-		return {{elem_index / BlockSize}, {elem_index % BlockSize}};
+		return {{elem_index / block_size}, {elem_index % block_size}};
+	}
+	const std::byte*             base_;
+	const detail::shared_header* header_;
+	const std::atomic<uint64_t>* offsets_ = nullptr;
+};
+
+#if ENT_HAS_MMAP
+// A named POSIX shared memory object (shm_open) mapped into this process.
+// create() makes (or truncates) one of the given size, open() maps an
+// existing one. The object stays around until unlink() is called, even
+// after every mapping is gone. Errors are thrown as std::system_error.
+// NOTE: With glibc older than 2.34 you need to link with -lrt.
+struct shared_memory {
+	shared_memory() = default;
+	shared_memory(const shared_memory&) = delete;
+	shared_memory& operator=(const shared_memory&) = delete;
+	shared_memory(shared_memory&& other) noexcept
+		: data_{std::exchange(other.data_, nullptr)}
+		, size_{std::exchange(other.size_, 0)}
+	{}
+	shared_memory& operator=(shared_memory&& other) noexcept {
+		if (this != &other) {
+			unmap();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+	~shared_memory() { unmap(); }
+	[[nodiscard]] static
+	auto create(const char* name, size_t size) -> shared_memory {
+		const auto fd = ::shm_open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			throw_error("shm_open");
+		}
+		if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+			const auto error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "ftruncate");
+		}
+		return map(fd, size);
+	}
+	[[nodiscard]] static
+	auto open(const char* name) -> shared_memory {
+		const auto fd = ::shm_open(name, O_RDWR, 0);
+		if (fd < 0) {
+			throw_error("shm_open");
+		}
+		struct stat info = {};
+		if (::fstat(fd, &info) != 0) {
+			const auto error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "fstat");
+		}
+		return map(fd, static_cast<size_t>(info.st_size));
+	}
+	static auto unlink(const char* name) -> void {
+		::shm_unlink(name);
+	}
+	[[nodiscard]] auto get_bytes() const -> ent::span<std::byte> { return {static_cast<std::byte*>(data_), size_}; }
+private:
+	[[noreturn]] static
+	auto throw_error(const char* what) -> void {
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+	[[nodiscard]] static
+	auto map(int fd, size_t size) -> shared_memory {
+		const auto ptr   = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		const auto error = errno;
+		::close(fd);
+		if (ptr == MAP_FAILED) {
+			throw std::system_error(error, std::generic_category(), "mmap");
+		}
+		auto result  = shared_memory{};
+		result.data_ = ptr;
+		result.size_ = size;
+		return result;
 	}
-	block_t*            first_       = nullptr;
-	block_t*            last_        = nullptr;
-	std::atomic<size_t> block_count_ = 0;
-	std::vector<size_t> free_indices_;
-	std::mutex          mutex_;
+	auto unmap() -> void {
+		if (data_) {
+			::munmap(data_, size_);
+		}
+	}
+	void*  data_ = nullptr;
+	size_t size_ = 0;
 };
+#endif
 
 // A single-threaded table where rows can only be acquired and never released.
+// Rows are stored in chunks which double in size, starting at first_chunk_rows.
+// Each chunk is a single allocation holding an array for every column, so
+// growing the table allocates once for all of the columns, and chunks are
+// never moved or freed, so references to elements stay valid as the table
+// grows (just like ent::table.)
 template <typename... Ts>
 struct simple_table {
+	static constexpr size_t first_chunk_rows = 64;
+	simple_table() = default;
+	simple_table(const simple_table& other) { *this = other; }
+	simple_table(simple_table&& other) noexcept
+		: chunks_{std::move(other.chunks_)}
+		, size_{std::exchange(other.size_, 0)}
+	{
+	}
+	simple_table& operator=(const simple_table& other) {
+		if (this != &other) {
+			destroy();
+			reserve(other.size());
+			for (size_t i = 0; i < other.size(); ++i) {
+				const auto [chunk, offset] = locate(i);
+				const auto [other_chunk, other_offset] = other.locate(i);
+				(new (std::get<Ts*>(chunks_[chunk].columns) + offset) Ts{std::get<Ts*>(other.chunks_[other_chunk].columns)[other_offset]}, ...);
+				size_++;
+			}
+		}
+		return *this;
+	}
+	simple_table& operator=(simple_table&& other) noexcept {
+		if (this != &other) {
+			destroy();
+			chunks_ = std::move(other.chunks_);
+			size_   = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+	~simple_table() { destroy(); }
+	// Makes sure there is room for row_count rows without allocating again.
+	auto reserve(size_t row_count) -> void {
+		while (get_capacity() < row_count) {
+			add_chunk();
+		}
+	}
 	auto resize(size_t size) -> void {
 		if (size <= this->size()) {
 			return;
 		}
-		(std::get<std::vector<Ts>>(data_).resize(size), ...);
+		reserve(size);
+		while (size_ < size) {
+			construct_row();
+		}
 	}
 	auto push_back() -> size_t {
-		const auto index = size();
-		(std::get<std::vector<Ts>>(data_).emplace_back(), ...);
+		reserve(size_ + 1);
+		const auto index = size_;
+		construct_row();
 		return index;
 	}
 	auto is_valid(size_t index) const -> bool {
 		return index < size();
 	}
-	auto size() const -> size_t { return std::get<0>(data_).size(); }
+	auto size() const -> size_t { return size_; }
+	[[nodiscard]]
+	auto get_capacity() const -> size_t { return chunk_begin(chunks_.size()); }
 	template <typename T> [[nodiscard]]
 	auto find(const T& value) const -> std::optional<size_t> {
-		size_t index = 0;
-		for (auto value_ : get<T>()) {
-			if (value_ == value) {
-				return index;
-			};
-			index++;
-		}
-		return std::nullopt;
+		std::optional<size_t> result;
+		scan_compare<ent::cmp::eq>(value, [&result](size_t base, detail::word_t bits) {
+			result = base + detail::ctz(bits);
+			return true;
+		});
+		return result;
+	}
+	// Vectorized queries, like the ones of ent::table.
+	template <typename T> [[nodiscard]]
+	auto find(ent::cmp op, const T& value) const -> std::optional<size_t> {
+		std::optional<size_t> result;
+		scan_compare(op, value, [&result](size_t base, detail::word_t bits) {
+			result = base + detail::ctz(bits);
+			return true;
+		});
+		return result;
+	}
+	template <typename T> [[nodiscard]]
+	auto count_if(ent::cmp op, const T& value) const -> size_t {
+		size_t result = 0;
+		scan_compare(op, value, [&result](size_t, detail::word_t bits) {
+			result += detail::popcount(bits);
+			return false;
+		});
+		return result;
+	}
+	template <typename T, typename OutIt>
+	auto find_all(ent::cmp op, const T& value, OutIt out) const -> OutIt {
+		scan_compare(op, value, [&out](size_t base, detail::word_t bits) {
+			while (bits) {
+				*out++ = base + detail::ctz(bits);
+				bits &= bits - 1;
+			}
+			return false;
+		});
+		return out;
+	}
+	template <typename T> [[nodiscard]]
+	auto get_sum() const -> T {
+		return *reduce<detail::reduction::sum, T>(T{});
+	}
+	template <typename T> [[nodiscard]]
+	auto get_min() const -> std::optional<T> {
+		return reduce<detail::reduction::min, T>(std::nullopt);
+	}
+	template <typename T> [[nodiscard]]
+	auto get_max() const -> std::optional<T> {
+		return reduce<detail::reduction::max, T>(std::nullopt);
 	}
 	template <typename T, typename Pred> [[nodiscard]]
 	auto find(Pred&& pred) const -> std::optional<size_t> {
-		size_t index = 0;
-		for (auto value : get<T>()) {
-			if (pred(value)) {
-				return index;
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			const auto values = std::get<T*>(chunks_[c].columns);
+			const auto count  = get_row_count(c);
+			for (size_t i = 0; i < count; ++i) {
+				if (pred(values[i])) {
+					return chunk_begin(c) + i;
+				}
 			}
-			index++;
 		}
 		return std::nullopt;
 	}
@@ -278,13 +3980,188 @@ struct simple_table {
 	auto set(size_t index, T&& value) -> void {
 		get<std::decay_t<T>>(index) = std::forward<T>(value);
 	}
-	template <typename T> [[nodiscard]] auto get() -> std::vector<T>& { return std::get<std::vector<T>>(data_); }
-	template <typename T> [[nodiscard]] auto get() const -> const std::vector<T>& { return std::get<std::vector<T>>(data_); }
-	template <typename T> [[nodiscard]] auto get(size_t index) -> T& { return std::get<std::vector<T>>(data_)[index]; }
-	template <typename T> [[nodiscard]] auto get(size_t index) const -> const T& { return std::get<std::vector<T>>(data_)[index]; }
+	// Visits every row, passing references to each of the requested columns:
+	//   table.visit<A, B>([](size_t index, A& a, B& b) { ... });
+	template <typename C, typename... Cs, typename Fn>
+	auto visit(Fn&& fn) -> void {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			visit_rows(chunk_begin(c), get_row_count(c), fn, std::get<C*>(chunks_[c].columns), std::get<Cs*>(chunks_[c].columns)...);
+		}
+	}
+	template <typename C, typename... Cs, typename Fn>
+	auto visit(Fn&& fn) const -> void {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			visit_rows(chunk_begin(c), get_row_count(c), fn, static_cast<const C*>(std::get<C*>(chunks_[c].columns)), static_cast<const Cs*>(std::get<Cs*>(chunks_[c].columns))...);
+		}
+	}
+	// Calls fn(base, ent::span<Cs>...) once per chunk with a span over each
+	// requested column, matching the signature of table::visit_spans. Element
+	// i of each span belongs to row (base + i).
+	template <typename... Cs, typename Fn>
+	auto visit_spans(Fn&& fn) -> void {
+		static_assert(sizeof...(Cs) > 0, "visit_spans requires at least one column");
+		for (size_t c = 0; c < chunks_.size() && get_row_count(c) > 0; ++c) {
+			fn(chunk_begin(c), ent::span<Cs>{std::get<Cs*>(chunks_[c].columns), get_row_count(c)}...);
+		}
+	}
+	template <typename... Cs, typename Fn>
+	auto visit_spans(Fn&& fn) const -> void {
+		static_assert(sizeof...(Cs) > 0, "visit_spans requires at least one column");
+		for (size_t c = 0; c < chunks_.size() && get_row_count(c) > 0; ++c) {
+			fn(chunk_begin(c), ent::span<const Cs>{std::get<Cs*>(chunks_[c].columns), get_row_count(c)}...);
+		}
+	}
+	// Writes the table to a file as a header followed by each column's values
+	// in row order. Like table::save(), the file is only meant to be loaded by
+	// builds with the same column types. Every column must be trivially
+	// copyable. Throws std::system_error if the file can't be written.
+	auto save(const char* path) const -> void {
+		static_assert((std::is_trivially_copyable_v<Ts> && ...), "Only trivially copyable columns can be saved");
+		auto file   = detail::file_writer{path};
+		auto header = detail::file_header{};
+		header.layout    = file_layout_hash();
+		header.row_count = size_;
+		file.write(&header, sizeof(header));
+		(save_column<Ts>(file), ...);
+		file.close();
+	}
+	// Replaces the contents of the table with a file written by save(), which
+	// is mapped into memory (where mmap is available) and copied in a chunk at
+	// a time. Throws std::runtime_error if the file wasn't saved from the same
+	// kind of table, or std::system_error if it can't be read.
+	auto load_mapped(const char* path) -> void {
+		static_assert((std::is_trivially_copyable_v<Ts> && ...), "Only trivially copyable columns can be loaded");
+		const auto file   = detail::mapped_file{path};
+		const auto bytes  = file.get_bytes();
+		const auto header = detail::read_file_header(bytes, file_layout_hash());
+		detail::check_file_size(bytes, header.row_count, (sizeof(Ts) + ...));
+		const auto row_count = static_cast<size_t>(header.row_count);
+		destroy();
+		reserve(row_count);
+		size_ = row_count;
+		auto src = bytes.data() + sizeof(header);
+		(load_column<Ts>(src), ...);
+	}
+	template <typename T> [[nodiscard]] auto get(size_t index) -> T&             { const auto [chunk, offset] = locate(index); return std::get<T*>(chunks_[chunk].columns)[offset]; }
+	template <typename T> [[nodiscard]] auto get(size_t index) const -> const T& { const auto [chunk, offset] = locate(index); return std::get<T*>(chunks_[chunk].columns)[offset]; }
 private:
-	using Tuple = std::tuple<std::vector<Ts>...>;
-	Tuple data_;
+	static_assert(sizeof...(Ts) > 0, "simple_table requires at least one column");
+	static_assert(((detail::count_of<Ts, Ts...> == 1) && ...), "Column types must be unique");
+	static constexpr size_t alignment = std::max({alignof(Ts)...});
+	struct chunk_t {
+		void*              memory = nullptr;
+		std::tuple<Ts*...> columns;
+	};
+	// The index of the first row of chunk c.
+	[[nodiscard]] static constexpr
+	auto chunk_begin(size_t c) -> size_t {
+		return first_chunk_rows * ((size_t{1} << c) - 1);
+	}
+	[[nodiscard]] static constexpr
+	auto chunk_rows(size_t c) -> size_t {
+		return first_chunk_rows << c;
+	}
+	[[nodiscard]] static
+	auto locate(size_t index) -> std::pair<size_t, size_t> {
+		const auto c = detail::highest_bit((index / first_chunk_rows) + 1);
+		return {c, index - chunk_begin(c)};
+	}
+	[[nodiscard]] static
+	auto get_chunk_bytes(size_t rows) -> size_t {
+		size_t bytes = 0;
+		((bytes = ((bytes + alignof(Ts) - 1) / alignof(Ts) * alignof(Ts)) + (rows * sizeof(Ts))), ...);
+		return bytes;
+	}
+	// The number of rows of chunk c which are in use.
+	[[nodiscard]]
+	auto get_row_count(size_t c) const -> size_t {
+		return std::min(chunk_rows(c), size_ - std::min(size_, chunk_begin(c)));
+	}
+	auto add_chunk() -> void {
+		const auto rows = chunk_rows(chunks_.size());
+		chunks_.reserve(chunks_.size() + 1);
+		chunk_t chunk;
+		chunk.memory = ::operator new(get_chunk_bytes(rows), std::align_val_t{alignment});
+		auto offset  = size_t{0};
+		((offset = (offset + alignof(Ts) - 1) / alignof(Ts) * alignof(Ts),
+		  std::get<Ts*>(chunk.columns) = reinterpret_cast<Ts*>(static_cast<char*>(chunk.memory) + offset),
+		  offset += rows * sizeof(Ts)), ...);
+		chunks_.push_back(chunk);
+	}
+	auto construct_row() -> void {
+		const auto [chunk, offset] = locate(size_);
+		(new (std::get<Ts*>(chunks_[chunk].columns) + offset) Ts{}, ...);
+		size_++;
+	}
+	auto destroy() -> void {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			const auto count = get_row_count(c);
+			(std::destroy_n(std::get<Ts*>(chunks_[c].columns), count), ...);
+			::operator delete(chunks_[c].memory, std::align_val_t{alignment});
+		}
+		chunks_.clear();
+		size_ = 0;
+	}
+	// Calls fn(elem_index, bits) for every run of (up to) 64 rows with matches
+	// until fn returns true.
+	template <typename T, typename Fn>
+	auto scan_compare(ent::cmp op, const T& value, Fn&& fn) const -> void {
+		detail::dispatch(op, [this, &value, &fn](auto op_) {
+			scan_compare<decltype(op_)::value>(value, fn);
+		});
+	}
+	// The comparison is a template argument here so that only that one
+	// operator has to exist for T.
+	template <ent::cmp Op, typename T, typename Fn>
+	auto scan_compare(const T& value, Fn&& fn) const -> void {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			const auto values = std::get<T*>(chunks_[c].columns);
+			const auto count  = get_row_count(c);
+			for (size_t i = 0; i < count; i += detail::word_bits) {
+				const auto bits = detail::compare_word<Op>(values + i, std::min(detail::word_bits, count - i), value);
+				if (bits && fn(chunk_begin(c) + i, bits)) {
+					return;
+				}
+			}
+		}
+	}
+	template <detail::reduction R, typename T> [[nodiscard]]
+	auto reduce(std::optional<T> acc) const -> std::optional<T> {
+		for (size_t c = 0; c < chunks_.size() && get_row_count(c) > 0; ++c) {
+			const auto values = std::get<T*>(chunks_[c].columns);
+			acc = detail::reduce_run<R>(values, get_row_count(c), acc ? *acc : values[0]);
+		}
+		return acc;
+	}
+	template <typename Fn, typename... Ptrs> static
+	auto visit_rows(size_t base, size_t count, Fn& fn, Ptrs... columns) -> void {
+		for (size_t i = 0; i < count; ++i) {
+			fn(base + i, columns[i]...);
+		}
+	}
+	[[nodiscard]] static constexpr
+	auto file_layout_hash() -> uint64_t {
+		// Zero rows per block, to tell these files apart from table files.
+		return detail::hash_layout({uint64_t{0}, uint64_t{sizeof(Ts)}...});
+	}
+	template <typename T>
+	auto save_column(detail::file_writer& file) const -> void {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			file.write(std::get<T*>(chunks_[c].columns), get_row_count(c) * sizeof(T));
+		}
+	}
+	// Copies size_ values of T from src into the (unconstructed) chunks, and
+	// moves src past them.
+	template <typename T>
+	auto load_column(const std::byte*& src) -> void {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			const auto bytes = get_row_count(c) * sizeof(T);
+			std::memcpy(static_cast<void*>(std::get<T*>(chunks_[c].columns)), src, bytes);
+			src += bytes;
+		}
+	}
+	std::vector<chunk_t> chunks_;
+	size_t               size_ = 0;
 };
 
 } // ent
\ No newline at end of file
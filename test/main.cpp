@@ -1,11 +1,33 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "ent.hpp"
+#if defined(ENT_TEST_PARALLEL_ALGORITHMS)
+#include <execution>
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <utility>
 
 struct S {
 	int value = 0;
 };
 
+struct NotZero {
+	int value = 7;
+};
+
+// Only has operator==, so it can be found but not compared in any other way.
+struct Id {
+	int value = 0;
+	auto operator==(const Id& other) const -> bool { return value == other.value; }
+};
+
+template <> struct ent::is_zero_initializable<S> : std::true_type {};
+
 TEST_CASE("table") {
 	ent::simple_table<int, float> store;
 	REQUIRE(store.size() == 0);
@@ -43,6 +65,16 @@ TEST_CASE("table") {
 	REQUIRE(store.get<float>(idx1) == 222.2f);
 }
 
+TEST_CASE("simple_table_find_equality_only") {
+	ent::simple_table<Id, int> store;
+	store.resize(100);
+	store.get<Id>(70).value = 5;
+	store.get<Id>(90).value = 5;
+	REQUIRE(store.find(Id{5}) == std::optional<size_t>{70});
+	REQUIRE(store.find(Id{0}) == std::optional<size_t>{0});
+	REQUIRE(!store.find(Id{6}));
+}
+
 TEST_CASE("sparse_table") {
 	ent::table<512, int, float, S> store;
 	//REQUIRE(store.size() == 0);
@@ -98,3 +130,1506 @@ TEST_CASE("sparse_table") {
 	store.release(ent::lock, idx0);
 	REQUIRE(store.get<int>(idx1) == 222);
 }
+
+TEST_CASE("sparse_table_many_blocks") {
+	ent::table<4, int, float> store;
+	std::vector<size_t> indices;
+	for (int i = 0; i < 40; ++i) {
+		const auto idx = store.acquire(ent::lock);
+		store.get<int>(idx) = i;
+		indices.push_back(idx);
+	}
+	REQUIRE(store.get_capacity() == 40);
+	for (int i = 0; i < 40; ++i) {
+		REQUIRE(store.get<int>(indices[i]) == i);
+	}
+	auto moved = std::move(store);
+	REQUIRE(moved.get_capacity() == 40);
+	REQUIRE(moved.get<int>(indices[39]) == 39);
+	REQUIRE(store.get_capacity() == 0);
+}
+
+TEST_CASE("sparse_table_lock_free") {
+	ent::table<100, int> store;
+	REQUIRE(!store.try_acquire());
+	const auto first = store.acquire(ent::lock);
+	store.release(first);
+	std::vector<size_t> indices;
+	while (const auto idx = store.try_acquire()) {
+		indices.push_back(*idx);
+	}
+	REQUIRE(indices.size() == 100);
+	REQUIRE(store.get_capacity() == 100);
+	REQUIRE(store.get_active_row_count(ent::lock) == 100);
+	store.get<int>(indices[50]) = 50;
+	store.release(indices[50]);
+	REQUIRE(store.get_active_row_count(ent::lock) == 99);
+	const auto reused = store.try_acquire();
+	REQUIRE(reused);
+	REQUIRE(*reused == indices[50]);
+	REQUIRE(store.get<int>(*reused) == 0);
+	const auto grown = store.acquire(ent::lock);
+	REQUIRE(grown == 100);
+	REQUIRE(store.get_capacity() == 200);
+	store.clear(ent::lock);
+	REQUIRE(store.get_active_row_count(ent::lock) == 0);
+}
+
+TEST_CASE("sparse_table_lock_free_threads") {
+	ent::table<64, int> store;
+	for (int i = 0; i < 4; ++i) {
+		store.release(ent::lock, store.acquire(ent::lock));
+	}
+	std::vector<std::thread> threads;
+	std::atomic<bool> collision = false;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&store, &collision, t] {
+			for (int i = 0; i < 10000; ++i) {
+				const auto idx = store.try_acquire();
+				if (!idx) {
+					continue;
+				}
+				if (store.get<int>(*idx) != 0) {
+					collision = true;
+				}
+				store.get<int>(*idx) = t + 1;
+				if (store.get<int>(*idx) != t + 1) {
+					collision = true;
+				}
+				store.release(*idx);
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	REQUIRE(!collision);
+	REQUIRE(store.get_active_row_count(ent::lock) == 0);
+}
+
+TEST_CASE("sparse_table_visit_active") {
+	ent::table<100, int, float> store;
+	std::vector<size_t> indices;
+	for (int i = 0; i < 250; ++i) {
+		indices.push_back(store.acquire(ent::lock));
+		store.get<int>(indices.back()) = i;
+	}
+	for (int i = 0; i < 250; ++i) {
+		if (i % 10 != 0) {
+			store.release(ent::lock, indices[i]);
+		}
+	}
+	size_t visited = 0;
+	int sum        = 0;
+	store.visit_active<int>(ent::lock, [&](size_t idx, int& value) {
+		REQUIRE(store.get<int>(idx) == value);
+		sum += value;
+		visited++;
+	});
+	REQUIRE(visited == 25);
+	REQUIRE(sum == 3000);
+	visited = 0;
+	store.visit_active(ent::lock, [&](size_t) { visited++; });
+	REQUIRE(visited == 25);
+	const auto found = store.find_active<int>(ent::lock, [](int value) { return value == 0; });
+	REQUIRE(found);
+	REQUIRE(*found == indices[0]);
+	REQUIRE(!store.find_active<int>(ent::lock, [](int value) { return value == 11; }));
+}
+
+TEST_CASE("sparse_table_visit_spans") {
+	ent::table<64, int, float> store;
+	for (int i = 0; i < 100; ++i) {
+		const auto idx = store.acquire(ent::lock);
+		store.get<int>(idx) = i;
+	}
+	size_t blocks = 0;
+	store.visit_spans<int, float>(ent::lock, [&](size_t base, ent::span<int> ints, ent::span<float> floats) {
+		REQUIRE(base == blocks * 64);
+		REQUIRE(ints.size() == 64);
+		REQUIRE(floats.size() == 64);
+		for (size_t i = 0; i < ints.size(); ++i) {
+			floats[i] = static_cast<float>(ints[i]) * 0.5f;
+		}
+		blocks++;
+	});
+	REQUIRE(blocks == 2);
+	REQUIRE(store.get<float>(99) == 49.5f);
+	const auto& const_store = store;
+	float sum = 0.0f;
+	const_store.visit_spans<float>(ent::lock, [&](size_t, ent::span<const float> floats) {
+		for (auto value : floats) {
+			sum += value;
+		}
+	});
+	REQUIRE(sum == 2475.0f);
+	const auto row = store.get(99);
+	REQUIRE(std::get<int&>(row) == 99);
+	std::get<float&>(row) = 1.0f;
+	REQUIRE(store.get<float>(99) == 1.0f);
+}
+
+TEST_CASE("zipped_visit") {
+	ent::table<16, int, float, S> store;
+	for (int i = 0; i < 40; ++i) {
+		const auto idx = store.acquire(ent::lock);
+		store.get<int>(idx)   = i;
+		store.get<float>(idx) = 2.0f;
+	}
+	store.visit<int, float, S>(ent::lock, [&](size_t idx, int& a, float& b, S& c) {
+		REQUIRE(&a == &store.get<int>(idx));
+		c.value = static_cast<int>(static_cast<float>(a) * b);
+	});
+	REQUIRE(store.get<S>(39).value == 78);
+	size_t count = 0;
+	std::as_const(store).visit<S>(ent::lock, [&](size_t, const S&) { count++; });
+	REQUIRE(count == 48);
+	ent::simple_table<int, float> simple;
+	for (int i = 0; i < 10; ++i) {
+		simple.get<int>(simple.push_back()) = i;
+	}
+	simple.visit<int, float>([](size_t idx, int& a, float& b) {
+		REQUIRE(static_cast<size_t>(a) == idx);
+		b = static_cast<float>(a) + 0.5f;
+	});
+	REQUIRE(simple.get<float>(9) == 9.5f);
+	simple.visit_spans<float>([](size_t base, ent::span<float> b) {
+		REQUIRE(base == 0);
+		REQUIRE(b.size() == 10);
+		b[0] = 100.0f;
+	});
+	REQUIRE(simple.get<float>(0) == 100.0f);
+}
+
+TEST_CASE("parallel_visit") {
+	ent::table<100, int, float> store;
+	for (int i = 0; i < 1000; ++i) {
+		store.get<int>(store.acquire(ent::lock)) = i;
+	}
+	ent::thread_pool pool{3};
+	store.parallel_visit<int, float>(ent::lock, pool, [](size_t idx, int& a, float& b) {
+		REQUIRE_EQ(static_cast<size_t>(a), idx);
+		b = static_cast<float>(a) * 2.0f;
+	}, 30);
+	for (int i = 0; i < 1000; ++i) {
+		REQUIRE(store.get<float>(i) == static_cast<float>(i) * 2.0f);
+	}
+	std::atomic<size_t> visited = 0;
+	store.parallel_visit(ent::lock, pool, [&visited](size_t) { visited++; });
+	REQUIRE(visited == 1000);
+	visited = 0;
+	store.parallel_visit<int>(ent::lock, ent::serial_executor{}, [&visited](size_t, int&) { visited++; });
+	REQUIRE(visited == 1000);
+	REQUIRE_THROWS(pool(10, [](size_t i) { if (i == 5) { throw std::runtime_error("task failed"); } }));
+}
+
+TEST_CASE("aligned_columns") {
+	struct alignas(4) Gain { float value = 1.0f; };
+	using table_t = ent::table<10, char, ent::aligned<float>, ent::aligned<Gain, 32>, int>;
+	table_t store;
+	const auto idx0 = store.acquire(ent::lock);
+	const auto idx1 = store.acquire(ent::lock);
+	store.set(idx1, 1.5f);
+	store.get<Gain>(idx1).value = 2.0f;
+	REQUIRE(store.get<float>(idx1) == 1.5f);
+	REQUIRE(store.get<Gain>(idx0).value == 1.0f);
+	REQUIRE(reinterpret_cast<uintptr_t>(&store.get<float>(idx0)) % ent::cache_line_size == 0);
+	REQUIRE(reinterpret_cast<uintptr_t>(&store.get<Gain>(idx0)) % 32 == 0);
+	const auto lines = [](const auto* first) {
+		const auto begin = reinterpret_cast<uintptr_t>(first) / ent::cache_line_size;
+		const auto end   = (reinterpret_cast<uintptr_t>(first + 10) - 1) / ent::cache_line_size;
+		return std::make_pair(begin, end);
+	};
+	const auto float_lines = lines(&store.get<float>(idx0));
+	for (const auto& other : {lines(&store.get<char>(idx0)), lines(&store.get<Gain>(idx0)), lines(&store.get<int>(idx0))}) {
+		REQUIRE((other.second < float_lines.first || other.first > float_lines.second));
+	}
+	const auto row = store.get(idx1);
+	REQUIRE(std::get<float&>(row) == 1.5f);
+	store.visit_spans<float>(ent::lock, [](size_t, ent::span<float> values) {
+		REQUIRE(reinterpret_cast<uintptr_t>(values.data()) % ent::cache_line_size == 0);
+	});
+}
+
+struct counting_allocator : ent::allocator {
+	size_t allocations   = 0;
+	size_t deallocations = 0;
+	auto allocate(size_t size, size_t alignment) -> void* override {
+		allocations++;
+		return ent::default_allocator().allocate(size, alignment);
+	}
+	auto deallocate(void* ptr, size_t size, size_t alignment) -> void override {
+		deallocations++;
+		ent::default_allocator().deallocate(ptr, size, alignment);
+	}
+};
+
+TEST_CASE("block_allocator") {
+	counting_allocator allocator;
+	{
+		ent::table<8, int, ent::aligned<float>> store{allocator};
+		store.reserve_blocks(ent::lock, 3);
+		REQUIRE(allocator.allocations == 3);
+		REQUIRE(store.get_capacity() == 0);
+		REQUIRE(store.get_reserved_block_count(ent::lock) == 3);
+		for (int i = 0; i < 24; ++i) {
+			store.get<int>(store.acquire(ent::lock)) = i;
+		}
+		REQUIRE(allocator.allocations == 3);
+		REQUIRE(store.get_reserved_block_count(ent::lock) == 0);
+		REQUIRE(store.get_capacity() == 24);
+		REQUIRE(store.get<float>(23) == 0.0f);
+		store.reserve_blocks(ent::lock, 1);
+		auto moved = std::move(store);
+		REQUIRE(moved.get<int>(23) == 23);
+		(void)moved.acquire(ent::lock);
+		REQUIRE(allocator.allocations == 4);
+	}
+	REQUIRE(allocator.deallocations == 4);
+}
+
+TEST_CASE("low_water_mark") {
+	counting_allocator allocator;
+	ent::table<8, int> store{allocator};
+	REQUIRE(!store.needs_maintenance());
+	store.set_low_water_mark(ent::lock, 4);
+	REQUIRE(store.needs_maintenance());
+	store.maintain(ent::lock);
+	REQUIRE(!store.needs_maintenance());
+	REQUIRE(allocator.allocations == 1);
+	REQUIRE(store.get_capacity() == 0);
+	for (int i = 0; i < 8; ++i) {
+		REQUIRE(store.try_acquire());
+	}
+	REQUIRE(store.get_capacity() == 8);
+	REQUIRE(store.needs_maintenance());
+	REQUIRE(!store.try_acquire());
+	store.maintain(ent::lock);
+	REQUIRE(allocator.allocations == 2);
+	store.maintain(ent::lock);
+	REQUIRE(allocator.allocations == 2);
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(store.try_acquire());
+	}
+	REQUIRE(store.get_capacity() == 16);
+	REQUIRE(!store.needs_maintenance());
+	store.set_low_water_mark(ent::lock, 20);
+	store.maintain(ent::lock);
+	REQUIRE(store.get_reserved_block_count(ent::lock) == 2);
+	REQUIRE(allocator.allocations == 4);
+}
+
+TEST_CASE("handles") {
+	ent::table<4, int, float> store;
+	REQUIRE(!store.is_alive(ent::handle{}));
+	const auto h0 = store.acquire_handle(ent::lock);
+	const auto h1 = store.acquire_handle(ent::lock);
+	REQUIRE(store.is_alive(h0));
+	REQUIRE(store.is_alive(h1));
+	REQUIRE(h0 != h1);
+	REQUIRE(h0.generation() % 2 == 1);
+	*store.try_get<int>(h0) = 111;
+	REQUIRE(store.get<int>(h0.index()) == 111);
+	REQUIRE(store.release(ent::lock, h0));
+	REQUIRE(!store.is_alive(h0));
+	REQUIRE(!store.try_get<int>(h0));
+	REQUIRE(!store.release(h0));
+	const auto h2 = store.try_acquire_handle();
+	REQUIRE(h2);
+	REQUIRE(h2->index() == h0.index());
+	REQUIRE(!store.is_alive(h0));
+	REQUIRE(store.is_alive(*h2));
+	REQUIRE(*std::as_const(store).try_get<int>(*h2) == 0);
+	store.release(ent::lock, h1.index());
+	REQUIRE(!store.is_alive(h1));
+	store.clear(ent::lock);
+	REQUIRE(!store.is_alive(*h2));
+	REQUIRE(!store.is_alive(ent::handle::make(100, 1)));
+}
+
+TEST_CASE("concurrent_handle_release") {
+	// Two threads race to release the same row every round. Exactly one of
+	// them should win, and the generation and the active count should only
+	// move once.
+	constexpr int rounds = 2000;
+	ent::table<64, int> store;
+	(void)store.acquire(ent::lock);
+	std::atomic<int> round   = -1;
+	std::atomic<int> done    = 0;
+	std::atomic<int> winners = 0;
+	ent::handle h;
+	const auto release_it = [&] {
+		for (int r = 0; r < rounds; ++r) {
+			while (round.load(std::memory_order_acquire) != r) {
+				std::this_thread::yield();
+			}
+			if (r % 2 == 0) {
+				winners += store.release(h) ? 1 : 0;
+			}
+			else {
+				store.release(h.index());
+			}
+			done++;
+		}
+	};
+	std::thread a{release_it};
+	std::thread b{release_it};
+	for (int r = 0; r < rounds; ++r) {
+		h       = store.acquire_handle(ent::lock);
+		winners = 0;
+		done    = 0;
+		round.store(r, std::memory_order_release);
+		while (done < 2) {
+			std::this_thread::yield();
+		}
+		if (r % 2 == 0) {
+			REQUIRE(winners == 1);
+		}
+		REQUIRE(!store.is_alive(h));
+		REQUIRE(store.get_handle(h.index()).generation() % 2 == 0);
+		REQUIRE(store.get_active_row_count(ent::lock) == 1);
+	}
+	a.join();
+	b.join();
+}
+
+TEST_CASE("acquire_n_release_n") {
+	ent::table<64, int, S> store;
+	(void)store.acquire(ent::lock);
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 200, std::back_inserter(indices));
+	REQUIRE(indices.size() == 200);
+	REQUIRE(store.get_capacity() == 256);
+	REQUIRE(store.get_active_row_count(ent::lock) == 201);
+	auto sorted = indices;
+	std::sort(sorted.begin(), sorted.end());
+	REQUIRE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+	REQUIRE(sorted.front() == 1);
+	for (const auto idx : indices) {
+		store.get<int>(idx)  = 5;
+		store.get<S>(idx).value = 6;
+		REQUIRE(store.is_alive(store.get_handle(idx)));
+	}
+	std::vector<size_t> released(indices.begin(), indices.begin() + 150);
+	std::swap(released[10], released[100]);
+	store.release_n(ent::lock, released);
+	REQUIRE(store.get_active_row_count(ent::lock) == 51);
+	for (const auto idx : released) {
+		REQUIRE(store.get<int>(idx) == 0);
+		REQUIRE(store.get<S>(idx).value == 0);
+	}
+	for (size_t i = 150; i < indices.size(); ++i) {
+		REQUIRE(store.get<int>(indices[i]) == 5);
+		REQUIRE(store.get<S>(indices[i]).value == 6);
+	}
+	std::vector<size_t> more;
+	store.acquire_n(ent::lock, 205, std::back_inserter(more));
+	REQUIRE(store.get_capacity() == 256);
+	REQUIRE(store.get_active_row_count(ent::lock) == 256);
+}
+
+TEST_CASE("zero_initializable_clear") {
+	static_assert(ent::is_zero_initializable_v<int>);
+	static_assert(ent::is_zero_initializable_v<S>);
+	static_assert(!ent::is_zero_initializable_v<NotZero>);
+	static_assert(!ent::is_zero_initializable_v<std::vector<int>>);
+	auto test = [](auto& store) {
+		for (int i = 0; i < 3000; ++i) {
+			const auto idx = store.acquire(ent::lock);
+			store.template get<int>(idx) = i + 1;
+			store.template get<S>(idx).value = i + 1;
+			store.template get<NotZero>(idx).value = i + 1;
+		}
+		store.clear(ent::lock);
+		for (size_t i = 0; i < store.get_capacity(); ++i) {
+			REQUIRE(store.template get<int>(i) == 0);
+			REQUIRE(store.template get<S>(i).value == 0);
+			REQUIRE(store.template get<NotZero>(i).value == 7);
+		}
+		const auto idx = store.acquire(ent::lock);
+		store.template get<NotZero>(idx).value = 1;
+		store.release(ent::lock, idx);
+		REQUIRE(store.template get<NotZero>(idx).value == 7);
+	};
+	ent::table<32, int, S, NotZero> store;
+	test(store);
+#if ENT_HAS_MMAP
+	ent::page_allocator allocator;
+	ent::table<65536, int, S, NotZero> big_store{allocator};
+	test(big_store);
+#endif
+}
+
+TEST_CASE("clear_lazy") {
+	ent::table<16, int, NotZero> store;
+	std::vector<ent::handle> handles;
+	for (int i = 0; i < 64; ++i) {
+		handles.push_back(store.acquire_handle(ent::lock));
+		store.get<int>(handles.back().index()) = i + 1;
+		store.get<NotZero>(handles.back().index()).value = i + 1;
+	}
+	store.clear_lazy(ent::lock);
+	REQUIRE(store.get_active_row_count(ent::lock) == 0);
+	REQUIRE(store.get_capacity() == 64);
+	for (const auto h : handles) {
+		REQUIRE(!store.is_alive(h));
+	}
+	size_t visited = 0;
+	store.visit_active(ent::lock, [&visited](size_t) { visited++; });
+	REQUIRE(visited == 0);
+	// Releasing an index from before the clear does nothing.
+	store.release(ent::lock, handles[20].index());
+	REQUIRE(store.get_active_row_count(ent::lock) == 0);
+	// The first block is refreshed when it is needed again...
+	const auto idx = store.try_acquire();
+	REQUIRE(idx);
+	REQUIRE(*idx == 0);
+	for (size_t i = 0; i < 16; ++i) {
+		REQUIRE(store.get<int>(i) == 0);
+		REQUIRE(store.get<NotZero>(i).value == 7);
+	}
+	// ...while the others are still stale.
+	REQUIRE(store.get<int>(30) == 31);
+	store.visit_active(ent::lock, [&visited](size_t) { visited++; });
+	REQUIRE(visited == 1);
+	std::vector<size_t> more;
+	store.acquire_n(ent::lock, 20, std::back_inserter(more));
+	REQUIRE(store.get<int>(more.back()) == 0);
+	REQUIRE(store.get_capacity() == 64);
+	store.maintain(ent::lock);
+	REQUIRE(store.get<int>(63) == 0);
+	REQUIRE(store.get<NotZero>(63).value == 7);
+	REQUIRE(store.get_active_row_count(ent::lock) == 21);
+	store.clear_lazy(ent::lock);
+	for (int i = 0; i < 64; ++i) {
+		(void)store.acquire(ent::lock);
+	}
+	REQUIRE(store.get_capacity() == 64);
+	store.clear(ent::lock);
+	REQUIRE(store.acquire(ent::lock) == 0);
+}
+
+TEST_CASE("compact") {
+	counting_allocator allocator;
+	ent::table<16, int, S> store{allocator};
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 100, std::back_inserter(indices));
+	for (const auto idx : indices) {
+		store.get<int>(idx)     = static_cast<int>(idx);
+		store.get<S>(idx).value = static_cast<int>(idx) * 2;
+	}
+	// Keep every 7th row.
+	std::vector<size_t> released;
+	std::vector<int> kept;
+	for (const auto idx : indices) {
+		if (idx % 7 == 0) {
+			kept.push_back(static_cast<int>(idx));
+		}
+		else {
+			released.push_back(idx);
+		}
+	}
+	store.release_n(ent::lock, released);
+	const auto stale = store.get_handle(98);
+	REQUIRE(store.is_alive(stale));
+	std::vector<std::pair<size_t, size_t>> remaps;
+	const auto moved = store.compact(ent::lock, [&remaps](size_t from, size_t to) { remaps.emplace_back(from, to); });
+	REQUIRE(moved == remaps.size());
+	REQUIRE(store.get_capacity() == 16);
+	REQUIRE(store.get_active_row_count(ent::lock) == kept.size());
+	REQUIRE(store.get_reserved_block_count(ent::lock) == 6);
+	REQUIRE(!store.is_alive(stale));
+	std::vector<int> values;
+	store.visit_active<int, S>(ent::lock, [&values, &kept](size_t idx, int& value, S& s) {
+		REQUIRE(idx < kept.size());
+		REQUIRE(s.value == value * 2);
+		values.push_back(value);
+	});
+	std::sort(values.begin(), values.end());
+	REQUIRE(values == kept);
+	for (const auto& [from, to] : remaps) {
+		REQUIRE(store.get<int>(to) == static_cast<int>(from));
+	}
+	// Parked blocks are reused without allocating.
+	const auto allocations = allocator.allocations;
+	std::vector<size_t> more;
+	store.acquire_n(ent::lock, 80, std::back_inserter(more));
+	REQUIRE(allocator.allocations == allocations);
+	REQUIRE(store.get<int>(more.back()) == 0);
+	store.free_reserved_blocks(ent::lock);
+	REQUIRE(store.get_reserved_block_count(ent::lock) == 0);
+	store.clear(ent::lock);
+	REQUIRE(store.compact(ent::lock, [](size_t, size_t) {}) == 0);
+	REQUIRE(store.get_capacity() == 0);
+	REQUIRE(store.acquire(ent::lock) == 0);
+}
+
+TEST_CASE("dirty_tracking") {
+	ent::table<100, ent::tracked<int>, ent::aligned<ent::tracked<float>>, S> store;
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 150, std::back_inserter(indices));
+	const auto consume_ints = [&store] {
+		std::vector<size_t> dirty;
+		store.consume_dirty<int>([&dirty](size_t idx, int&) { dirty.push_back(idx); });
+		return dirty;
+	};
+	REQUIRE(consume_ints().empty());
+	store.set(5, 55);
+	store.set(120, 1200);
+	store.get<int>(130) = 1300;
+	store.mark_dirty<int>(130);
+	store.get<S>(6).value = 1;
+	std::vector<std::pair<size_t, int>> seen;
+	store.consume_dirty<int>([&seen](size_t idx, int& value) { seen.emplace_back(idx, value); });
+	REQUIRE(seen == std::vector<std::pair<size_t, int>>{{5, 55}, {120, 1200}, {130, 1300}});
+	REQUIRE(consume_ints().empty());
+	size_t floats = 0;
+	store.consume_dirty<float>([&floats](size_t, float&) { floats++; });
+	REQUIRE(floats == 0);
+	store.release(ent::lock, 120);
+	REQUIRE(consume_ints() == std::vector<size_t>{120});
+	store.clear(ent::lock);
+	REQUIRE(consume_ints().size() == 200);
+	store.consume_dirty<float>([&floats](size_t, float&) { floats++; });
+	REQUIRE(floats == 200);
+}
+
+TEST_CASE("buffered_columns") {
+	struct Pos { float x = 0.0f; float y = 0.0f; };
+	ent::table<16, ent::buffered<Pos>, ent::tracked<ent::buffered<int>>, S> store;
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 20, std::back_inserter(indices));
+	store.set(3, Pos{1.0f, 2.0f});
+	store.set(17, 170);
+	REQUIRE(store.read_committed().get<Pos>(3).x == 0.0f);
+	store.commit();
+	auto view = store.read_committed();
+	REQUIRE(view.get<Pos>(3).y == 2.0f);
+	REQUIRE(view.get<int>(17) == 170);
+	store.set(3, Pos{5.0f, 6.0f});
+	store.get<S>(3).value = 9;
+	store.commit();
+	// The view doesn't change until the reader asks for the new one.
+	REQUIRE(view.get<Pos>(3).x == 1.0f);
+	REQUIRE(view.get<S>(3).value == 9);
+	store.set(3, Pos{7.0f, 8.0f});
+	store.commit();
+	view = store.read_committed();
+	REQUIRE(view.get<Pos>(3).x == 7.0f);
+	const auto row = view.get(3);
+	REQUIRE(std::get<const Pos&>(row).y == 8.0f);
+	REQUIRE(view.get_span<int>(1)[1] == 170);
+	std::atomic<bool> done = false;
+	std::atomic<bool> torn = false;
+	std::thread reader{[&] {
+		while (!done) {
+			const auto v = store.read_committed();
+			const auto& p = v.get<Pos>(5);
+			if (p.x != p.y || v.get<int>(5) != static_cast<int>(p.x)) {
+				torn = true;
+			}
+		}
+	}};
+	for (int i = 0; i < 2000; ++i) {
+		store.set(5, Pos{static_cast<float>(i), static_cast<float>(i)});
+		store.set(5, i);
+		store.commit();
+	}
+	done = true;
+	reader.join();
+	REQUIRE(!torn);
+}
+
+TEST_CASE("buffered_commit_while_growing") {
+	// commit() doesn't take the lock, so it can run while acquire() adds
+	// blocks and reallocates the block directory.
+	ent::table<4, ent::buffered<int>> store;
+	std::atomic<bool> done = false;
+	std::thread writer{[&] {
+		while (!done) {
+			store.commit();
+		}
+	}};
+	for (int i = 0; i < 4000; ++i) {
+		(void)store.acquire(ent::lock);
+	}
+	done = true;
+	writer.join();
+	store.commit();
+	REQUIRE(store.get_capacity() == 4000);
+	REQUIRE(store.read_committed().get<int>(3999) == 0);
+}
+
+TEST_CASE("indexed_columns") {
+	ent::table<64, ent::indexed<int>, float> store;
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 1000, std::back_inserter(indices));
+	for (const auto idx : indices) {
+		store.set(ent::lock, idx, static_cast<int>(idx) * 10);
+	}
+	for (const auto idx : indices) {
+		REQUIRE(store.find_by(static_cast<int>(idx) * 10) == idx);
+	}
+	REQUIRE(!store.find_by(5));
+	store.set(ent::lock, 7, 12345);
+	REQUIRE(!store.find_by(70));
+	REQUIRE(store.find_by(12345) == 7);
+	store.get<int>(8) = 54321;
+	store.reindex<int>(ent::lock, 8);
+	REQUIRE(store.find_by(54321) == 8);
+	REQUIRE(!store.find_by(80));
+	store.release(ent::lock, 9);
+	REQUIRE(!store.find_by(90));
+	// Released rows are never returned, even if the index couldn't be updated.
+	store.release(10);
+	REQUIRE(!store.find_by(100));
+	store.set(ent::lock, 10, 100);
+	REQUIRE(!store.find_by(100));
+	// Compaction moves rows from the end into the free rows at the start.
+	std::vector<std::pair<size_t, size_t>> moves;
+	store.compact(ent::lock, [&moves](size_t from, size_t to) { moves.emplace_back(from, to); });
+	REQUIRE(moves.size() == 2);
+	for (const auto& [from, to] : moves) {
+		REQUIRE(store.find_by(static_cast<int>(from) * 10) == to);
+	}
+	store.clear(ent::lock);
+	REQUIRE(!store.find_by(12345));
+	REQUIRE(!store.find_by(0));
+	const auto idx = store.acquire(ent::lock);
+	store.set(ent::lock, idx, 42);
+	REQUIRE(store.find_by(42) == idx);
+	std::atomic<bool> done  = false;
+	std::atomic<bool> wrong = false;
+	std::thread reader{[&] {
+		while (!done) {
+			if (!store.find_by(42)) {
+				wrong = true;
+			}
+			if (const auto found = store.find_by(-1)) {
+				wrong = true;
+			}
+		}
+	}};
+	// Enough churn to make the index rebuild itself a few times.
+	for (int i = 0; i < 5000; ++i) {
+		const auto other = store.acquire(ent::lock);
+		store.set(ent::lock, other, 1000 + i);
+		store.release(ent::lock, other);
+	}
+	done = true;
+	reader.join();
+	REQUIRE(!wrong);
+}
+
+TEST_CASE("ordered_columns") {
+	struct Clip { int id = 0; };
+	ent::table<32, ent::ordered<double>, Clip> store;
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 500, std::back_inserter(indices));
+	// Insert in a scrambled order so that the delta buffer gets merged a few
+	// times.
+	for (size_t i = 0; i < indices.size(); ++i) {
+		const auto idx = indices[(i * 7) % indices.size()];
+		store.set(ent::lock, idx, static_cast<double>(idx % 100));
+		store.get<Clip>(idx).id = static_cast<int>(idx);
+	}
+	const auto query = [&store](double lo, double hi) {
+		std::vector<std::pair<double, size_t>> result;
+		store.visit_in_range<double, Clip>(ent::lock, lo, hi, [&result](size_t idx, const double& start, Clip& clip) {
+			REQUIRE(clip.id == static_cast<int>(idx));
+			result.emplace_back(start, idx);
+		});
+		return result;
+	};
+	auto result = query(10.0, 12.0);
+	REQUIRE(result.size() == 10);
+	REQUIRE(std::is_sorted(result.begin(), result.end()));
+	REQUIRE(result.front() == std::pair<double, size_t>{10.0, 10});
+	REQUIRE(result.back() == std::pair<double, size_t>{11.0, 411});
+	store.set(ent::lock, 10, 50.5);
+	store.release(ent::lock, 110);
+	// Released without the lock, so the index still has it.
+	store.release(11);
+	result = query(10.0, 12.0);
+	REQUIRE(result.size() == 7);
+	REQUIRE(result.front().second == 210);
+	REQUIRE(query(50.5, 50.6) == std::vector<std::pair<double, size_t>>{{50.5, 10}});
+	store.get<double>(20) = 0.25;
+	store.reindex<double>(ent::lock, 20);
+	REQUIRE(query(0.0, 0.5) == std::vector<std::pair<double, size_t>>{{0.0, 0}, {0.0, 100}, {0.0, 200}, {0.0, 300}, {0.0, 400}, {0.25, 20}});
+	REQUIRE(query(20.0, 21.0).size() == 4);
+	REQUIRE(query(200.0, 300.0).empty());
+	store.compact(ent::lock, [](size_t, size_t) {});
+	size_t total = 0;
+	store.visit_in_range<double>(ent::lock, 0.0, 100.0, [&total](size_t, const double&) { total++; });
+	REQUIRE(total == 498);
+	store.clear(ent::lock);
+	REQUIRE(query(0.0, 100.0).empty());
+}
+
+TEST_CASE("grouped_columns") {
+	struct Pos { float x = 0.0f; float y = 0.0f; };
+	struct Vel { float x = 0.0f; float y = 0.0f; };
+	struct Name { int id = 5; };
+	ent::table<16, ent::group<Pos, Vel, float>, Name, ent::group<NotZero, S>> store;
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 40, std::back_inserter(indices));
+	// The columns of a group are interleaved, each row's values are together.
+	const auto row_begin = reinterpret_cast<const char*>(&store.get<Pos>(3));
+	const auto row_size  = sizeof(std::tuple<Pos, Vel, float>);
+	for (const auto member : {reinterpret_cast<const char*>(&store.get<Vel>(3)), reinterpret_cast<const char*>(&store.get<float>(3))}) {
+		REQUIRE(std::abs(member - row_begin) < static_cast<std::ptrdiff_t>(row_size));
+	}
+	REQUIRE(reinterpret_cast<const char*>(&store.get<Pos>(4)) - row_begin == static_cast<std::ptrdiff_t>(row_size));
+	for (const auto idx : indices) {
+		store.set(idx, Pos{static_cast<float>(idx), 0.0f});
+		store.set(idx, Vel{1.0f, 2.0f});
+		store.set(idx, 0.5f);
+	}
+	REQUIRE(store.get<NotZero>(7).value == 7);
+	store.visit<Pos, Vel, float>(ent::lock, [](size_t, Pos& p, const Vel& v, float gain) {
+		p.x += v.x * gain;
+		p.y += v.y * gain;
+	});
+	REQUIRE(store.get<Pos>(10).x == 10.5f);
+	REQUIRE(store.get<Pos>(10).y == 1.0f);
+	REQUIRE(std::get<Name&>(store.get(10)).id == 5);
+	REQUIRE(store.find<Pos>(ent::lock, [](const Pos& p) { return p.x == 20.5f; }) == std::optional<size_t>{20});
+	float total = 0.0f;
+	store.parallel_visit<float>(ent::lock, ent::serial_executor{}, [&total](size_t, float gain) { total += gain; }, 4);
+	REQUIRE(total == 20.0f);
+	store.get<NotZero>(7).value = 1;
+	store.release(ent::lock, 7);
+	REQUIRE(store.get<Pos>(7).x == 0.0f);
+	REQUIRE(store.get<NotZero>(7).value == 7);
+	std::vector<size_t> moved;
+	store.compact(ent::lock, [&moved](size_t, size_t to) { moved.push_back(to); });
+	REQUIRE(moved == std::vector<size_t>{7});
+	REQUIRE(store.get<Pos>(7).x == 39.5f);
+	store.get<S>(3).value = 4;
+	store.get<NotZero>(3).value = 4;
+	store.clear(ent::lock);
+	REQUIRE(store.get<Pos>(3).x == 0.0f);
+	REQUIRE(store.get<S>(3).value == 0);
+	REQUIRE(store.get<NotZero>(3).value == 7);
+}
+
+TEST_CASE("simple_table_chunks") {
+	ent::simple_table<int, NotZero, double> store;
+	store.reserve(10);
+	REQUIRE(store.get_capacity() == store.first_chunk_rows);
+	REQUIRE(store.size() == 0);
+	const auto first = store.push_back();
+	auto& ref = store.get<int>(first);
+	ref = 42;
+	// Growing never moves existing rows.
+	store.resize(1000);
+	REQUIRE(&store.get<int>(first) == &ref);
+	REQUIRE(store.size() == 1000);
+	REQUIRE(store.get_capacity() >= 1000);
+	REQUIRE(store.get<NotZero>(999).value == 7);
+	REQUIRE(store.get<double>(500) == 0.0);
+	store.visit<int, double>([](size_t idx, int& a, double& b) {
+		if (idx > 0) {
+			a = static_cast<int>(idx);
+		}
+		b = static_cast<double>(idx) * 2.0;
+	});
+	REQUIRE(store.find(500) == std::optional<size_t>{500});
+	REQUIRE(store.find(42) == std::optional<size_t>{0});
+	REQUIRE(store.find<double>([](double d) { return d > 1997.0; }) == std::optional<size_t>{999});
+	size_t rows     = 0;
+	size_t expected = 0;
+	store.visit_spans<int>([&](size_t base, ent::span<int> a) {
+		REQUIRE(base == expected);
+		REQUIRE(a[0] == (base == 0 ? 42 : static_cast<int>(base)));
+		rows     += a.size();
+		expected += a.size();
+	});
+	REQUIRE(rows == 1000);
+	auto copy = store;
+	REQUIRE(copy.size() == 1000);
+	REQUIRE(copy.get<int>(700) == 700);
+	REQUIRE(&copy.get<int>(700) != &store.get<int>(700));
+	const auto moved = std::move(copy);
+	REQUIRE(moved.get<double>(999) == 1998.0);
+}
+
+TEST_CASE("vectorized_queries") {
+	enum class Note : int32_t { none = 0 };
+	const auto note = [](int n) { return static_cast<Note>(n); };
+	ent::table<100, int, unsigned, float, Note, double> store;
+	std::vector<size_t> indices;
+	store.acquire_n(ent::lock, 450, std::back_inserter(indices));
+	for (const auto idx : indices) {
+		const auto i = static_cast<int>(idx);
+		store.set(idx, (i % 37) - 18);
+		store.set(idx, static_cast<unsigned>(i) * 0x01000193u);
+		store.set(idx, static_cast<float>(i % 50) * 0.5f);
+		store.set(idx, note(i % 128));
+		store.set(idx, static_cast<double>(i));
+	}
+	// Free rows don't match even though their values are zero.
+	for (size_t idx = 0; idx < 450; idx += 7) {
+		store.release(ent::lock, idx);
+	}
+	const auto scalar = [&](ent::cmp op, auto value) {
+		using T = decltype(value);
+		std::vector<size_t> result;
+		store.visit_active<T>(ent::lock, [&](size_t idx, const T& v) {
+			bool match = false;
+			switch (op) {
+				case ent::cmp::eq: match = v == value; break;
+				case ent::cmp::ne: match = v != value; break;
+				case ent::cmp::lt: match = v < value; break;
+				case ent::cmp::le: match = v <= value; break;
+				case ent::cmp::gt: match = v > value; break;
+				case ent::cmp::ge: match = v >= value; break;
+			}
+			if (match) {
+				result.push_back(idx);
+			}
+		});
+		return result;
+	};
+	const auto check = [&](auto value) {
+		using T = decltype(value);
+		for (const auto op : {ent::cmp::eq, ent::cmp::ne, ent::cmp::lt, ent::cmp::le, ent::cmp::gt, ent::cmp::ge}) {
+			const auto expected = scalar(op, value);
+			std::vector<size_t> found;
+			store.find_all<T>(ent::lock, op, value, std::back_inserter(found));
+			REQUIRE(found == expected);
+			REQUIRE(store.count_if<T>(ent::lock, op, value) == expected.size());
+			const auto first = store.find<T>(ent::lock, op, value);
+			REQUIRE(first == (expected.empty() ? std::nullopt : std::optional<size_t>{expected.front()}));
+		}
+	};
+	check(3);
+	check(-18);
+	check(0x80000000u);
+	check(static_cast<unsigned>(200) * 0x01000193u);
+	check(12.5f);
+	check(note(64));
+	check(100.0);
+	REQUIRE(!store.find<int>(ent::lock, ent::cmp::gt, 18));
+	REQUIRE(store.find<Note>(ent::lock, ent::cmp::eq, note(0)) == std::optional<size_t>{128});
+	int sum = 0;
+	std::optional<unsigned> min;
+	std::optional<unsigned> max;
+	store.visit_active<int, unsigned>(ent::lock, [&](size_t, int a, unsigned b) {
+		sum += a;
+		min = min ? std::min(*min, b) : b;
+		max = max ? std::max(*max, b) : b;
+	});
+	REQUIRE(store.get_sum<int>(ent::lock) == sum);
+	REQUIRE(store.get_min<unsigned>(ent::lock) == min);
+	REQUIRE(store.get_max<unsigned>(ent::lock) == max);
+	REQUIRE(store.get_max<float>(ent::lock) == 24.5f);
+	REQUIRE(store.get_min<double>(ent::lock) == 1.0);
+	REQUIRE(store.get_sum<double>(ent::lock) == 450.0 * 449.0 / 2.0 - (7.0 * 64.0 * 65.0 / 2.0));
+	store.clear(ent::lock);
+	REQUIRE(!store.get_min<int>(ent::lock));
+	REQUIRE(store.get_sum<float>(ent::lock) == 0.0f);
+	ent::simple_table<float, int> simple;
+	simple.resize(300);
+	for (size_t i = 0; i < 300; ++i) {
+		simple.set(i, static_cast<float>(i) - 100.0f);
+		simple.set(i, static_cast<int>(i % 10));
+	}
+	REQUIRE(simple.find(150.0f) == std::optional<size_t>{250});
+	REQUIRE(simple.find(ent::cmp::ge, 9) == std::optional<size_t>{9});
+	REQUIRE(simple.count_if(ent::cmp::lt, 0.0f) == 100);
+	std::vector<size_t> sevens;
+	simple.find_all(ent::cmp::eq, 7, std::back_inserter(sevens));
+	REQUIRE(sevens.size() == 30);
+	REQUIRE(sevens.back() == 297);
+	REQUIRE(simple.get_min<float>() == -100.0f);
+	REQUIRE(simple.get_max<float>() == 199.0f);
+	REQUIRE(simple.get_sum<int>() == 1350);
+	REQUIRE(!ent::simple_table<int>{}.get_max<int>());
+}
+
+TEST_CASE("export_import") {
+	using store_t = ent::table<100, ent::indexed<int>, float, NotZero>;
+	store_t source;
+	std::vector<size_t> indices;
+	source.acquire_n(ent::lock, 250, std::back_inserter(indices));
+	for (const auto idx : indices) {
+		source.set(ent::lock, idx, static_cast<int>(idx) + 1);
+		source.set(idx, static_cast<float>(idx) * 0.5f);
+		source.get<NotZero>(idx).value = 1;
+	}
+	for (size_t idx = 0; idx < 250; idx += 3) {
+		source.release(ent::lock, idx);
+	}
+	// Each block is a handful of contiguous byte ranges.
+	std::vector<std::vector<std::byte>> blocks;
+	source.export_blocks<int, float>(ent::lock, [&blocks](size_t b, ent::span<const std::byte> occupancy, ent::span<const std::byte> ints, ent::span<const std::byte> floats) {
+		REQUIRE(b == blocks.size());
+		REQUIRE(occupancy.size() == 2 * sizeof(uint64_t));
+		REQUIRE(ints.size() == 100 * sizeof(int));
+		REQUIRE(floats.size() == 100 * sizeof(float));
+		auto& bytes = blocks.emplace_back();
+		for (const auto part : {occupancy, ints, floats}) {
+			bytes.insert(bytes.end(), part.begin(), part.end());
+		}
+	});
+	REQUIRE(blocks.size() == 3);
+	store_t dest;
+	dest.acquire_n(ent::lock, 1000, std::back_inserter(indices));
+	const auto old_handle = dest.get_handle(5);
+	dest.import_blocks<int, float>(ent::lock, blocks.size(), [&blocks](size_t b, ent::span<std::byte> occupancy, ent::span<std::byte> ints, ent::span<std::byte> floats) {
+		auto src = blocks[b].data();
+		for (const auto part : {occupancy, ints, floats}) {
+			std::memcpy(part.data(), src, part.size());
+			src += part.size();
+		}
+	});
+	REQUIRE(!dest.is_alive(old_handle));
+	REQUIRE(dest.get_active_row_count(ent::lock) == source.get_active_row_count(ent::lock));
+	std::vector<size_t> source_rows;
+	std::vector<size_t> dest_rows;
+	source.visit_active(ent::lock, [&source_rows](size_t idx) { source_rows.push_back(idx); });
+	dest.visit_active(ent::lock, [&dest_rows](size_t idx) { dest_rows.push_back(idx); });
+	REQUIRE(dest_rows == source_rows);
+	for (const auto idx : dest_rows) {
+		REQUIRE(dest.get<int>(idx) == static_cast<int>(idx) + 1);
+		REQUIRE(dest.get<float>(idx) == static_cast<float>(idx) * 0.5f);
+		// Columns which weren't imported are reset.
+		REQUIRE(dest.get<NotZero>(idx).value == 7);
+		REQUIRE(dest.find_by(static_cast<int>(idx) + 1) == idx);
+	}
+	REQUIRE(!dest.find_by(1));
+	REQUIRE(dest.is_alive(dest.get_handle(1)));
+	const auto next = dest.acquire(ent::lock);
+	REQUIRE(next % 3 == 0);
+}
+
+TEST_CASE("shared_tables") {
+	using store_t = ent::table<100, int, ent::tracked<float>>;
+	using other_t = ent::table<100, int, double>;
+	// Two views of the same memory at different addresses, like two processes.
+	std::vector<std::byte> local(ent::shared_allocator<store_t>::region_size(3) + 64);
+	const auto aligned = reinterpret_cast<std::byte*>((reinterpret_cast<uintptr_t>(local.data()) + 63) / 64 * 64);
+	auto writer_region = ent::span<std::byte>{aligned, local.size() - 64};
+#if ENT_HAS_MMAP
+	const auto name = "/ent_test_shared_tables";
+	auto writer_memory = ent::shared_memory::create(name, ent::shared_allocator<store_t>::region_size(3));
+	auto reader_memory = ent::shared_memory::open(name);
+	ent::shared_memory::unlink(name);
+	REQUIRE(writer_memory.get_bytes().data() != reader_memory.get_bytes().data());
+	writer_region = writer_memory.get_bytes();
+	const auto reader_region = ent::span<const std::byte>{reader_memory.get_bytes().data(), reader_memory.get_bytes().size()};
+#else
+	const auto reader_region = ent::span<const std::byte>{writer_region.data(), writer_region.size()};
+#endif
+	auto allocator = ent::shared_allocator<store_t>{writer_region};
+	REQUIRE(allocator.get_max_blocks() == 3);
+	REQUIRE_THROWS_AS(ent::shared_view<other_t>{reader_region}, std::invalid_argument);
+	const auto view = ent::shared_view<store_t>{reader_region};
+	REQUIRE(view.get_block_count() == 0);
+	{
+		store_t table{allocator};
+		std::vector<size_t> indices;
+		table.acquire_n(ent::lock, 250, std::back_inserter(indices));
+		for (const auto idx : indices) {
+			table.get<int>(idx) = static_cast<int>(idx) * 2;
+			table.set(idx, static_cast<float>(idx) + 0.5f);
+		}
+		REQUIRE(view.get_block_count() == 3);
+		REQUIRE(view.get<int>(123) == 246);
+		REQUIRE(view.get<float>(249) == 249.5f);
+		const auto handle = view.get_handle(10);
+		REQUIRE(handle == table.get_handle(10));
+		REQUIRE(view.is_alive(handle));
+		table.release(ent::lock, 10);
+		REQUIRE(!view.is_alive(handle));
+		size_t visited = 0;
+		view.visit_active<int, float>([&visited](size_t idx, int a, float b) {
+			REQUIRE(a == static_cast<int>(idx) * 2);
+			REQUIRE(b == static_cast<float>(idx) + 0.5f);
+			visited++;
+		});
+		REQUIRE(visited == 249);
+		// The region only has room for three blocks.
+		REQUIRE_THROWS_AS(table.acquire_n(ent::lock, 100, std::back_inserter(indices)), std::bad_alloc);
+		table.clear_lazy(ent::lock);
+		visited = 0;
+		view.visit_active([&visited](size_t) { visited++; });
+		REQUIRE(visited == 0);
+		REQUIRE(!view.is_alive(table.get_handle(20)));
+		const auto idx = table.acquire(ent::lock);
+		REQUIRE(view.is_alive(table.get_handle(idx)));
+	}
+	REQUIRE(view.get_block_count() == 0);
+}
+
+TEST_CASE("save_load") {
+	const auto dir = std::filesystem::temp_directory_path();
+	const auto path = (dir / "ent_test_save_load.ent").string();
+	SUBCASE("table") {
+		using store_t = ent::table<100, ent::indexed<int>, float, NotZero>;
+		store_t source;
+		std::vector<size_t> indices;
+		source.acquire_n(ent::lock, 250, std::back_inserter(indices));
+		for (const auto idx : indices) {
+			source.set(ent::lock, idx, static_cast<int>(idx) + 1);
+			source.set(idx, static_cast<float>(idx) * 0.25f);
+			source.get<NotZero>(idx).value = static_cast<int>(idx);
+		}
+		for (size_t idx = 0; idx < 250; idx += 4) {
+			source.release(ent::lock, idx);
+		}
+		source.save(ent::lock, path.c_str());
+		store_t dest;
+		dest.load_mapped(ent::lock, path.c_str());
+		REQUIRE(dest.get_active_row_count(ent::lock) == source.get_active_row_count(ent::lock));
+		size_t visited = 0;
+		source.visit_active<int, float, NotZero>(ent::lock, [&dest, &visited](size_t idx, int a, float b, NotZero c) {
+			REQUIRE(dest.is_alive(dest.get_handle(idx)));
+			REQUIRE(dest.get<int>(idx) == a);
+			REQUIRE(dest.get<float>(idx) == b);
+			REQUIRE(dest.get<NotZero>(idx).value == c.value);
+			REQUIRE(dest.find_by(a) == idx);
+			visited++;
+		});
+		REQUIRE(visited == 187);
+		REQUIRE(dest.get_active_row_count(ent::lock) == 187);
+		// A file saved from a different kind of table is rejected.
+		ent::table<100, int, double> other;
+		REQUIRE_THROWS_AS(other.load_mapped(ent::lock, path.c_str()), std::runtime_error);
+		ent::simple_table<int, float, NotZero> simple;
+		REQUIRE_THROWS_AS(simple.load_mapped(path.c_str()), std::runtime_error);
+		// So are truncated files.
+		std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+		REQUIRE_THROWS_AS(dest.load_mapped(ent::lock, path.c_str()), std::runtime_error);
+	}
+	SUBCASE("simple_table") {
+		ent::simple_table<int, double> source;
+		for (int i = 0; i < 1000; ++i) {
+			const auto idx = source.push_back();
+			source.set(idx, i * 3);
+			source.set(idx, i * 0.5);
+		}
+		source.save(path.c_str());
+		ent::simple_table<int, double> dest;
+		dest.push_back();
+		dest.load_mapped(path.c_str());
+		REQUIRE(dest.size() == 1000);
+		for (size_t i = 0; i < 1000; ++i) {
+			REQUIRE(dest.get<int>(i) == static_cast<int>(i) * 3);
+			REQUIRE(dest.get<double>(i) == static_cast<double>(i) * 0.5);
+		}
+		REQUIRE(dest.get_sum<int>() == source.get_sum<int>());
+		dest.push_back();
+		REQUIRE(dest.size() == 1001);
+		{
+			std::ofstream garbage{path, std::ios::binary | std::ios::trunc};
+			garbage << "not an ent file at all, but long enough to have a header";
+		}
+		REQUIRE_THROWS_AS(dest.load_mapped(path.c_str()), std::runtime_error);
+		REQUIRE_THROWS_AS(dest.load_mapped((dir / "ent_test_missing.ent").string().c_str()), std::system_error);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("stats") {
+	ent::table<64, int> table;
+	std::vector<size_t> indices;
+	for (int i = 0; i < 100; ++i) {
+		indices.push_back(table.acquire(ent::lock));
+	}
+	table.acquire_n(ent::lock, 50, std::back_inserter(indices));
+	for (size_t i = 0; i < 30; ++i) {
+		table.release(ent::lock, indices[i]);
+	}
+	table.release(indices[30]);
+	REQUIRE(table.try_acquire_handle());
+	table.clear_lazy(ent::lock);
+	const auto stats = table.get_stats();
+	const auto total = [](const ent::table_stats::histogram_t& histogram) {
+		return std::accumulate(histogram.begin(), histogram.end(), uint64_t{0});
+	};
+#if defined(ENT_STATS)
+	REQUIRE(stats.acquires == 151);
+	REQUIRE(stats.releases == 31);
+	REQUIRE(stats.clears == 1);
+	REQUIRE(stats.failed_try_acquires == 0);
+	REQUIRE(stats.blocks_added == 3);
+	REQUIRE(stats.block_allocations == 3);
+	REQUIRE(stats.peak_active_rows == 150);
+	REQUIRE(total(stats.search_depth) >= 101);
+	REQUIRE(total(stats.lock_wait_ns) == 132);
+	REQUIRE(total(stats.lock_hold_ns) == 132);
+#else
+	REQUIRE(stats.acquires == 0);
+	REQUIRE(stats.peak_active_rows == 0);
+	REQUIRE(total(stats.lock_wait_ns) == 0);
+#endif
+}
+
+TEST_CASE("local_cache") {
+	using store_t = ent::table<64, int, NotZero>;
+	SUBCASE("single thread") {
+		store_t table;
+		{
+			store_t::local_cache cache{table, 8};
+			REQUIRE(!cache.try_acquire());
+			const auto a = cache.acquire(ent::lock);
+			REQUIRE(cache.size() == 7);
+			REQUIRE(table.get_active_row_count(ent::lock) == 8);
+			table.get<int>(a) = 5;
+			table.get<NotZero>(a).value = 9;
+			const auto h = table.get_handle(a);
+			REQUIRE(table.is_alive(h));
+			cache.release(a);
+			REQUIRE(!table.is_alive(h));
+			REQUIRE(table.get<int>(a) == 0);
+			REQUIRE(table.get<NotZero>(a).value == 7);
+			// The most recently released row comes back first.
+			REQUIRE(cache.try_acquire() == a);
+			REQUIRE(table.is_alive(table.get_handle(a)));
+			std::vector<size_t> rows;
+			for (int i = 0; i < 40; ++i) {
+				rows.push_back(cache.acquire(ent::lock));
+			}
+			REQUIRE(table.get_active_row_count(ent::lock) == 48);
+			for (const auto row : rows) {
+				cache.release(row);
+			}
+			// No more than two batches are kept.
+			REQUIRE(cache.size() <= 16);
+			REQUIRE(table.get_active_row_count(ent::lock) == cache.size() + 1);
+			cache.flush();
+			REQUIRE(cache.size() == 0);
+			REQUIRE(table.get_active_row_count(ent::lock) == 1);
+			(void)cache.acquire(ent::lock);
+			REQUIRE(table.get_active_row_count(ent::lock) == 9);
+			// Rows released by something else are dropped from the cache.
+			table.clear(ent::lock);
+			const auto b = cache.acquire(ent::lock);
+			REQUIRE(b < 64);
+			REQUIRE(table.get_active_row_count(ent::lock) == 8);
+			// Releasing a row which isn't acquired does nothing.
+			const auto size = cache.size();
+			const auto c    = table.acquire(ent::lock);
+			table.release(ent::lock, c);
+			cache.release(c);
+			REQUIRE(cache.size() == size);
+			REQUIRE(table.get_handle(c).generation() % 2 == 0);
+			REQUIRE(table.get_active_row_count(ent::lock) == 8);
+			// Neither does releasing a row of a block which was cleared lazily.
+			table.clear_lazy(ent::lock);
+			cache.release(b);
+			REQUIRE(cache.size() == size);
+			REQUIRE(table.get_active_row_count(ent::lock) == 0);
+			(void)cache.acquire(ent::lock);
+			REQUIRE(table.get_active_row_count(ent::lock) == 8);
+		}
+		REQUIRE(table.get_active_row_count(ent::lock) == 1);
+	}
+	SUBCASE("compact") {
+		store_t table;
+		store_t::local_cache cache{table, 4};
+		const auto a = cache.acquire(ent::lock);
+		cache.release(a);
+		// compact() would move the cached rows and leave them stuck.
+		REQUIRE_THROWS_AS(table.compact(ent::lock, [](size_t, size_t) {}), std::logic_error);
+		cache.flush();
+		REQUIRE(table.get_active_row_count(ent::lock) == 0);
+		table.compact(ent::lock, [](size_t, size_t) {});
+		(void)cache.acquire(ent::lock);
+		REQUIRE_THROWS_AS(table.compact(ent::lock, [](size_t, size_t) {}), std::logic_error);
+		{
+			store_t::local_cache other{table, 4};
+			(void)other.acquire(ent::lock);
+		}
+		cache.flush();
+		table.compact(ent::lock, [](size_t, size_t) {});
+		// Just the two rows which were handed out.
+		REQUIRE(table.get_active_row_count(ent::lock) == 2);
+	}
+	SUBCASE("threads") {
+		store_t table;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&table] {
+				store_t::local_cache cache{table, 16};
+				std::vector<size_t> live;
+				for (int i = 0; i < 20000; ++i) {
+					if (live.size() < 40 && (i % 3) != 0) {
+						const auto idx = cache.acquire(ent::lock);
+						REQUIRE(table.get<int>(idx) == 0);
+						table.get<int>(idx) = i;
+						live.push_back(idx);
+					}
+					else if (!live.empty()) {
+						cache.release(live.back());
+						live.pop_back();
+					}
+				}
+				for (const auto idx : live) {
+					cache.release(idx);
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		REQUIRE(table.get_active_row_count(ent::lock) == 0);
+	}
+}
+
+namespace {
+// Only knows about the columns it uses, not the whole table.
+auto sum_active(const ent::column_view<64, int, float>& view) -> float {
+	float total = 0.0f;
+	view.visit_active<int, float>([&total](size_t, int a, float b) { total += static_cast<float>(a) * b; });
+	return total;
+}
+} // namespace
+
+TEST_CASE("column_views") {
+	ent::table<64, int, float, double, NotZero, ent::aligned<char, 32>> table;
+	std::vector<size_t> indices;
+	table.acquire_n(ent::lock, 150, std::back_inserter(indices));
+	for (const auto idx : indices) {
+		table.get<int>(idx)   = static_cast<int>(idx);
+		table.get<float>(idx) = 2.0f;
+	}
+	table.release(ent::lock, 0);
+	auto view = table.view<int, float>(ent::lock);
+	REQUIRE(view.get_block_count() == 3);
+	REQUIRE(view.get_capacity() == 192);
+	REQUIRE(view.get<int>(149) == 149);
+	REQUIRE_THROWS_AS((void)view.get<int>(192), std::out_of_range);
+	// Writes through the view are writes to the table.
+	view.get<float>(1) = 4.0f;
+	REQUIRE(table.get<float>(1) == 4.0f);
+	REQUIRE(sum_active(view) == static_cast<float>((149 * 150 / 2) * 2 + 2));
+	size_t visited = 0;
+	view.visit<int>([&visited](size_t idx, int& a) {
+		REQUIRE(a == (idx < 150 ? static_cast<int>(idx) : 0));
+		visited++;
+	});
+	REQUIRE(visited == 192);
+	size_t spans = 0;
+	view.visit_spans<float, int>([&spans](size_t base, ent::span<float> b, ent::span<int> a) {
+		REQUIRE(base == spans * 64);
+		REQUIRE(b.size() == 64);
+		REQUIRE(a[5] == (base + 5 < 150 ? static_cast<int>(base + 5) : 0));
+		spans++;
+	});
+	REQUIRE(spans == 3);
+	std::vector<std::thread> threads;
+	std::vector<float> totals(4);
+	for (size_t t = 0; t < totals.size(); ++t) {
+		threads.emplace_back([&view, &totals, t] { totals[t] = sum_active(view); });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	REQUIRE(std::all_of(totals.begin(), totals.end(), [&totals](float total) { return total == totals[0]; }));
+	table.clear_lazy(ent::lock);
+	size_t active = 0;
+	view.visit_active([&active](size_t) { active++; });
+	REQUIRE(active == 0);
+}
+
+TEST_CASE("column_iterators") {
+	ent::table<64, int, float, NotZero> table;
+	std::vector<size_t> indices;
+	table.acquire_n(ent::lock, 150, std::back_inserter(indices));
+	for (const auto idx : indices) {
+		table.get<int>(idx)   = static_cast<int>(200 - idx);
+		table.get<float>(idx) = 0.5f;
+	}
+	const auto view = table.view<int, float>(ent::lock);
+	const auto ints = view.column<int>();
+	using iterator = decltype(ints.begin());
+	static_assert(std::is_same_v<std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>);
+	static_assert(std::is_same_v<std::iterator_traits<iterator>::reference, int&>);
+	static_assert(std::is_same_v<decltype(ints.begin().operator->()), int*>);
+	REQUIRE(ints.size() == 192);
+	REQUIRE(ints.end() - ints.begin() == 192);
+	REQUIRE(ints.begin()[70] == 130);
+	REQUIRE(*(ints.begin() + 149) == 51);
+	REQUIRE((ints.end() - 1).index() == 191);
+	// Random access across block boundaries.
+	std::sort(ints.begin(), ints.end());
+	REQUIRE(std::is_sorted(ints.begin(), ints.end()));
+	REQUIRE(table.get<int>(0) == 0);
+	REQUIRE(table.get<int>(42) == 51);
+	REQUIRE(table.get<int>(191) == 200);
+	const auto rows = view.rows<int, float>();
+	// Rows are a proxy range.
+	static_assert(std::is_same_v<std::iterator_traits<decltype(rows.begin())>::iterator_category, std::input_iterator_tag>);
+	static_assert(std::is_same_v<decltype(rows)::iterator::reference, std::tuple<int&, float&>>);
+	REQUIRE(rows.end() - rows.begin() == 192);
+	const auto total = std::transform_reduce(rows.begin(), rows.end(), 0.0f, std::plus<>{}, [](std::tuple<int&, float&> row) {
+		return static_cast<float>(std::get<0>(row)) * std::get<1>(row);
+	});
+	// Rows 42 to 149 have both a value and a weight after sorting.
+	REQUIRE(total == static_cast<float>((51 + 158) * 108 / 2) * 0.5f);
+	// Segments are stored in the view, so they are a real random access range.
+	const auto segments = view.segments();
+	static_assert(std::is_same_v<std::iterator_traits<decltype(segments.begin())>::reference, const std::tuple<size_t, ent::span<int>, ent::span<float>>&>);
+	REQUIRE(segments.size() == 3);
+	const auto scale = [](const std::tuple<size_t, ent::span<int>, ent::span<float>>& segment) {
+		auto& [base, ints, floats] = segment;
+		REQUIRE(base % 64 == 0);
+		for (size_t i = 0; i < floats.size(); ++i) {
+			floats[i] *= static_cast<float>(ints[i]);
+		}
+	};
+#if defined(ENT_TEST_PARALLEL_ALGORITHMS)
+	std::for_each(std::execution::par, segments.begin(), segments.end(), scale);
+#else
+	std::for_each(segments.begin(), segments.end(), scale);
+#endif
+	REQUIRE(table.get<float>(42) == 25.5f);
+	REQUIRE(table.get<float>(160) == 0.0f);
+	// So are columns.
+	const auto floats = view.column<float>();
+	const auto add    = [](float f, int i) { return f + static_cast<float>(i); };
+#if defined(ENT_TEST_PARALLEL_ALGORITHMS)
+	std::transform(std::execution::par, floats.begin(), floats.end(), ints.begin(), floats.begin(), add);
+#else
+	std::transform(floats.begin(), floats.end(), ints.begin(), floats.begin(), add);
+#endif
+	REQUIRE(table.get<float>(42) == 76.5f);
+	REQUIRE(table.get<float>(160) == 169.0f);
+}
+
+TEST_CASE("deferred_acquire_release") {
+	using store_t = ent::table<64, ent::indexed<int>, float>;
+	SUBCASE("single thread") {
+		store_t table;
+		REQUIRE(!table.defer_acquire());
+		REQUIRE(!table.defer_release(0));
+		table.reserve_deferred(ent::lock, 10, 4);
+		REQUIRE(table.get_active_row_count(ent::lock) == 10);
+		std::vector<size_t> rows;
+		for (int i = 0; i < 10; ++i) {
+			const auto idx = table.defer_acquire();
+			REQUIRE(idx);
+			rows.push_back(*idx);
+		}
+		REQUIRE(!table.defer_acquire());
+		table.set(ent::lock, rows[0], 42);
+		REQUIRE(table.find_by(42) == rows[0]);
+		REQUIRE(table.flush(ent::lock) == 0);
+		REQUIRE(table.get_active_row_count(ent::lock) == 20);
+		const auto h = table.get_handle(rows[0]);
+		for (size_t i = 0; i < 4; ++i) {
+			REQUIRE(table.defer_release(rows[i]));
+		}
+		// The queue is full.
+		REQUIRE(!table.defer_release(rows[4]));
+		REQUIRE(table.is_alive(h));
+		REQUIRE(table.flush(ent::lock) == 4);
+		REQUIRE(!table.is_alive(h));
+		REQUIRE(!table.find_by(42));
+		REQUIRE(table.get_active_row_count(ent::lock) == 16);
+		// Pooled rows released by clear() are skipped.
+		table.clear(ent::lock);
+		REQUIRE(!table.defer_acquire());
+		table.flush(ent::lock);
+		REQUIRE(table.defer_acquire());
+		// Reconfiguring gives the old pool back.
+		table.reserve_deferred(ent::lock, 2, 2);
+		REQUIRE(table.get_active_row_count(ent::lock) == 3);
+	}
+	SUBCASE("clear and compact") {
+		store_t table;
+		table.reserve_deferred(ent::lock, 8, 8);
+		// A flush straight after a clear fills the pool again.
+		table.clear(ent::lock);
+		REQUIRE(table.get_active_row_count(ent::lock) == 0);
+		table.flush(ent::lock);
+		REQUIRE(table.get_active_row_count(ent::lock) == 8);
+		table.clear_lazy(ent::lock);
+		table.flush(ent::lock);
+		REQUIRE(table.get_active_row_count(ent::lock) == 8);
+		const auto a = table.defer_acquire();
+		REQUIRE(a);
+		// A release queued before a clear doesn't hit the row which has the same
+		// index afterwards.
+		REQUIRE(table.defer_release(*a));
+		table.clear(ent::lock);
+		std::vector<size_t> rows;
+		table.acquire_n(ent::lock, 100, std::back_inserter(rows));
+		for (const auto row : rows) {
+			table.get<float>(row) = 7.0f;
+		}
+		REQUIRE(table.flush(ent::lock) == 0);
+		REQUIRE(table.get<float>(*a) == 7.0f);
+		REQUIRE(table.get_active_row_count(ent::lock) == 108);
+		// compact() gives the pool back, moves the live rows down, then fills the
+		// pool again, so nothing leaks.
+		for (size_t i = 0; i < 90; ++i) {
+			table.release(ent::lock, rows[i]);
+		}
+		REQUIRE(table.defer_release(rows[95]));
+		size_t moved = 0;
+		table.compact(ent::lock, [&moved](size_t, size_t) { moved++; });
+		REQUIRE(moved > 0);
+		REQUIRE(table.flush(ent::lock) == 0);
+		REQUIRE(table.get_active_row_count(ent::lock) == 17);
+		size_t fresh = 0;
+		while (const auto row = table.defer_acquire()) {
+			REQUIRE(table.get<float>(*row) == 0.0f);
+			fresh++;
+		}
+		REQUIRE(fresh == 8);
+		size_t visited = 0;
+		table.visit_active<float>(ent::lock, [&visited](size_t, float& value) { visited += value == 7.0f ? 1 : 0; });
+		REQUIRE(visited == 9);
+	}
+	SUBCASE("threads") {
+		store_t table;
+		table.reserve_deferred(ent::lock, 256, 1024);
+		std::atomic<bool> done = false;
+		std::atomic<size_t> acquired = 0;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 3; ++t) {
+			threads.emplace_back([&table, &acquired] {
+				std::vector<size_t> live;
+				for (int i = 0; i < 20000; ++i) {
+					if (live.size() < 16) {
+						if (const auto idx = table.defer_acquire()) {
+							table.get<float>(*idx) = 1.0f;
+							live.push_back(*idx);
+							acquired++;
+						}
+					}
+					else {
+						while (!table.defer_release(live.back())) {
+							std::this_thread::yield();
+						}
+						live.pop_back();
+					}
+				}
+				for (const auto idx : live) {
+					while (!table.defer_release(idx)) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		std::thread flusher{[&table, &done] {
+			while (!done) {
+				table.flush(ent::lock);
+				std::this_thread::yield();
+			}
+		}};
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		done = true;
+		flusher.join();
+		table.flush(ent::lock);
+		REQUIRE(acquired > 0);
+		REQUIRE(table.get_active_row_count(ent::lock) == 256);
+	}
+}